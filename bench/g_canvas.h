@@ -0,0 +1,12 @@
+/*
+	The parts of Pd's g_canvas.h the sensel external uses
+*/
+#ifndef SENSEL_BENCH_G_CANVAS_H
+#define SENSEL_BENCH_G_CANVAS_H
+
+typedef struct _glist t_canvas;
+
+t_canvas *canvas_getcurrent(void);
+void canvas_makefilename(const t_canvas *c, const char *file, char *result, int resultsize);
+
+#endif
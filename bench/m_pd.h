@@ -0,0 +1,121 @@
+/*
+	The parts of Pd's m_pd.h the sensel external uses, just
+	enough to build it into the benchmark against the stub
+	runtime in pd_stub.c instead of a running Pd
+*/
+#ifndef SENSEL_BENCH_M_PD_H
+#define SENSEL_BENCH_M_PD_H
+
+#include <stddef.h>
+
+typedef float t_float;
+typedef float t_floatarg;
+typedef float t_sample;
+typedef long t_int;
+
+typedef struct _symbol
+{
+	const char *s_name;
+	void *s_thing;
+	struct _symbol *s_next;
+} t_symbol;
+
+typedef union word
+{
+	t_float w_float;
+	t_symbol *w_symbol;
+	void *w_gpointer;
+} t_word;
+
+typedef enum
+{
+	A_NULL, A_FLOAT, A_SYMBOL, A_POINTER, A_SEMI, A_COMMA,
+	A_DEFFLOAT, A_DEFSYM, A_DOLLAR, A_DOLLSYM, A_GIMME, A_CANT
+} t_atomtype;
+
+typedef struct _atom
+{
+	t_atomtype a_type;
+	union word a_w;
+} t_atom;
+
+typedef struct _class t_class;
+typedef struct _outlet t_outlet;
+typedef struct _clock t_clock;
+typedef struct _garray t_garray;
+typedef t_class *t_pd;
+
+typedef struct _gobj
+{
+	t_pd g_pd;
+	struct _gobj *g_next;
+} t_gobj;
+
+typedef struct _object
+{
+	t_gobj te_g;
+	void *te_binbuf;
+	t_outlet *te_outlet;
+} t_object;
+
+typedef struct _signal
+{
+	int s_n;
+	t_sample *s_vec;
+	t_float s_sr;
+} t_signal;
+
+typedef void (*t_method)(void);
+typedef void *(*t_newmethod)(void);
+typedef t_int *(*t_perfroutine)(t_int *w);
+
+#define MAXPDSTRING 1000
+#define CLASS_DEFAULT 0
+
+#define SETFLOAT(atom, f) ((atom)->a_type = A_FLOAT, (atom)->a_w.w_float = (f))
+#define SETSYMBOL(atom, s) ((atom)->a_type = A_SYMBOL, (atom)->a_w.w_symbol = (s))
+
+extern t_symbol s_list, s_float, s_signal;
+extern t_class *garray_class;
+
+void *getbytes(size_t nbytes);
+void freebytes(void *x, size_t nbytes);
+void *resizebytes(void *x, size_t oldsize, size_t newsize);
+
+void post(const char *fmt, ...);
+void error(const char *fmt, ...);
+
+t_symbol *gensym(const char *s);
+
+t_outlet *outlet_new(t_object *owner, t_symbol *s);
+void outlet_float(t_outlet *x, t_float f);
+void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv);
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv);
+
+t_clock *clock_new(void *owner, t_method fn);
+void clock_free(t_clock *x);
+void clock_delay(t_clock *x, double delaytime);
+void clock_unset(t_clock *x);
+double clock_gettimesince(double prevsystime);
+
+t_class *class_new(t_symbol *name, t_newmethod newmethod, t_method freemethod,
+	size_t size, int flags, t_atomtype arg1, ...);
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel, t_atomtype arg1, ...);
+void class_addbang(t_class *c, t_method fn);
+void class_sethelpsymbol(t_class *c, t_symbol *s);
+
+t_pd *pd_new(t_class *cls);
+void *pd_findbyclass(t_symbol *s, const t_class *c);
+
+int garray_getfloatwords(t_garray *x, int *size, t_word **vec);
+void garray_resize_long(t_garray *x, long n);
+void garray_redraw(t_garray *x);
+
+t_float atom_getfloat(const t_atom *a);
+t_symbol *atom_getsymbol(const t_atom *a);
+t_float atom_getfloatarg(int which, int argc, const t_atom *argv);
+t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv);
+
+void dsp_add(t_perfroutine f, int n, ...);
+
+#endif
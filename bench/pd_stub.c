@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+#include "pd_stub.h"
+#include "g_canvas.h"
+
+/*
+	Stub Pd runtime, see pd_stub.h
+*/
+#define STUB_TICK_MSEC		(64.0 * 1000.0 / 44100.0)	// one DSP block
+#define STUB_SYMBOLS		1024
+
+t_stub_counts stub_counts;
+
+t_symbol s_list = { "list", NULL, NULL };
+t_symbol s_float = { "float", NULL, NULL };
+t_symbol s_signal = { "signal", NULL, NULL };
+t_class *garray_class = NULL;
+
+struct _class
+{
+	size_t c_size;
+};
+
+struct _outlet
+{
+	t_object *o_owner;
+};
+
+struct _clock
+{
+	void *c_owner;
+	t_method c_fn;
+	double c_when;			// logical msec it is due at
+	int c_set;
+	struct _clock *c_next;
+};
+
+static pthread_mutex_t stub_clocks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static t_clock *stub_clocks;
+static double stub_logical;		// logical msec since the start
+static double stub_start;		// wall clock msec at the start, 0 before
+
+static double stub_wall_msec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0);
+}
+
+/*
+	Memory
+*/
+void *getbytes(size_t nbytes)
+{
+	atomic_fetch_add_explicit(&stub_counts.c_allocations, 1, memory_order_relaxed);
+	return(calloc(1, nbytes ? nbytes : 1));
+}
+
+void freebytes(void *x, size_t nbytes)
+{
+	(void)nbytes;
+	free(x);
+}
+
+void *resizebytes(void *x, size_t oldsize, size_t newsize)
+{
+	char *y;
+
+	atomic_fetch_add_explicit(&stub_counts.c_allocations, 1, memory_order_relaxed);
+	y = (char *)realloc(x, newsize ? newsize : 1);
+	if (y != NULL && newsize > oldsize)
+		memset(y + oldsize, 0, newsize - oldsize);
+	return(y);
+}
+
+/*
+	Console
+*/
+void post(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+void error(const char *fmt, ...)
+{
+	va_list ap;
+
+	stub_counts.c_errors++;
+	va_start(ap, fmt);
+	fprintf(stderr, "error: ");
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+}
+
+/*
+	Symbols, interned in a hash table like Pd's own
+*/
+static t_symbol *stub_symbols[STUB_SYMBOLS];
+static pthread_mutex_t stub_symbols_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+t_symbol *gensym(const char *s)
+{
+	unsigned int hash = 5381;
+	t_symbol *sym;
+
+	for (const char *c = s; *c; c++)
+		hash = hash * 33 + (unsigned char)*c;
+	pthread_mutex_lock(&stub_symbols_mutex);
+	for (sym = stub_symbols[hash % STUB_SYMBOLS]; sym != NULL; sym = sym->s_next)
+		if (!strcmp(sym->s_name, s))
+			break;
+	if (sym == NULL)
+	{
+		sym = (t_symbol *)calloc(1, sizeof(t_symbol));
+		sym->s_name = strdup(s);
+		sym->s_next = stub_symbols[hash % STUB_SYMBOLS];
+		stub_symbols[hash % STUB_SYMBOLS] = sym;
+	}
+	pthread_mutex_unlock(&stub_symbols_mutex);
+	return(sym);
+}
+
+/*
+	Outlets only count what goes through them
+*/
+t_outlet *outlet_new(t_object *owner, t_symbol *s)
+{
+	t_outlet *x = (t_outlet *)calloc(1, sizeof(t_outlet));
+	(void)s;
+	x->o_owner = owner;
+	return(x);
+}
+
+void outlet_float(t_outlet *x, t_float f)
+{
+	(void)x;
+	(void)f;
+	stub_counts.c_messages++;
+	stub_counts.c_atoms++;
+}
+
+void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+	(void)x;
+	(void)s;
+	(void)argv;
+	stub_counts.c_lists++;
+	stub_counts.c_atoms += argc;
+}
+
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+	(void)x;
+	(void)s;
+	(void)argv;
+	stub_counts.c_messages++;
+	stub_counts.c_atoms += argc;
+}
+
+/*
+	Clocks. Pd's clock_delay() is called from the Sensel thread
+	as well, hence the mutex.
+*/
+t_clock *clock_new(void *owner, t_method fn)
+{
+	t_clock *x = (t_clock *)calloc(1, sizeof(t_clock));
+
+	x->c_owner = owner;
+	x->c_fn = fn;
+	pthread_mutex_lock(&stub_clocks_mutex);
+	x->c_next = stub_clocks;
+	stub_clocks = x;
+	pthread_mutex_unlock(&stub_clocks_mutex);
+	return(x);
+}
+
+void clock_free(t_clock *x)
+{
+	pthread_mutex_lock(&stub_clocks_mutex);
+	for (t_clock **c = &stub_clocks; *c != NULL; c = &(*c)->c_next)
+	{
+		if (*c == x)
+		{
+			*c = x->c_next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&stub_clocks_mutex);
+	free(x);
+}
+
+void clock_delay(t_clock *x, double delaytime)
+{
+	pthread_mutex_lock(&stub_clocks_mutex);
+	x->c_when = stub_logical + (delaytime > 0 ? delaytime : 0);
+	x->c_set = 1;
+	pthread_mutex_unlock(&stub_clocks_mutex);
+}
+
+void clock_unset(t_clock *x)
+{
+	pthread_mutex_lock(&stub_clocks_mutex);
+	x->c_set = 0;
+	pthread_mutex_unlock(&stub_clocks_mutex);
+}
+
+double clock_gettimesince(double prevsystime)
+{
+	return(stub_logical - prevsystime);
+}
+
+/*
+	Runs the earliest clock due by now, returning:
+		1 if one was run
+		0 if none is due
+*/
+static int stub_sched_clock(void)
+{
+	t_clock *due = NULL;
+
+	pthread_mutex_lock(&stub_clocks_mutex);
+	for (t_clock *c = stub_clocks; c != NULL; c = c->c_next)
+		if (c->c_set && c->c_when <= stub_logical && (due == NULL || c->c_when < due->c_when))
+			due = c;
+	if (due != NULL)
+		due->c_set = 0;
+	pthread_mutex_unlock(&stub_clocks_mutex);
+	if (due == NULL)
+		return(0);
+	((void (*)(void *))due->c_fn)(due->c_owner);
+	return(1);
+}
+
+void stub_sched_run(double msec)
+{
+	double end;
+
+	if (stub_start == 0)
+		stub_start = stub_wall_msec();
+	end = stub_wall_msec() + msec;
+	for (;;)
+	{
+		double wall = stub_wall_msec();
+
+		// catch up one DSP tick at a time, as Pd does after a
+		// stall, but give up at the end when overloaded
+		while (stub_logical + STUB_TICK_MSEC <= wall - stub_start && stub_wall_msec() < end)
+		{
+			pthread_mutex_lock(&stub_clocks_mutex);
+			stub_logical += STUB_TICK_MSEC;
+			pthread_mutex_unlock(&stub_clocks_mutex);
+			while (stub_wall_msec() < end && stub_sched_clock())
+				;
+		}
+		if (wall >= end)
+			break;
+
+		double sleep = stub_start + stub_logical + STUB_TICK_MSEC - wall;
+		struct timespec ts;
+		ts.tv_sec = 0;
+		ts.tv_nsec = (long)(sleep > 0 ? sleep * 1000000.0 : 0);
+		nanosleep(&ts, NULL);
+	}
+}
+
+/*
+	Classes and objects
+*/
+t_class *class_new(t_symbol *name, t_newmethod newmethod, t_method freemethod,
+	size_t size, int flags, t_atomtype arg1, ...)
+{
+	t_class *c = (t_class *)calloc(1, sizeof(t_class));
+	(void)name;
+	(void)newmethod;
+	(void)freemethod;
+	(void)flags;
+	(void)arg1;
+	c->c_size = size;
+	return(c);
+}
+
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel, t_atomtype arg1, ...)
+{
+	(void)c;
+	(void)fn;
+	(void)sel;
+	(void)arg1;
+}
+
+void class_addbang(t_class *c, t_method fn)
+{
+	(void)c;
+	(void)fn;
+}
+
+void class_sethelpsymbol(t_class *c, t_symbol *s)
+{
+	(void)c;
+	(void)s;
+}
+
+t_pd *pd_new(t_class *cls)
+{
+	t_pd *x = (t_pd *)calloc(1, cls->c_size);
+	*x = cls;
+	return(x);
+}
+
+void stub_pd_free(void *x)
+{
+	free(x);
+}
+
+void *pd_findbyclass(t_symbol *s, const t_class *c)
+{
+	(void)s;
+	(void)c;
+	return(NULL);
+}
+
+/*
+	There are no arrays, so the force image is never copied
+*/
+int garray_getfloatwords(t_garray *x, int *size, t_word **vec)
+{
+	(void)x;
+	*size = 0;
+	*vec = NULL;
+	return(0);
+}
+
+void garray_resize_long(t_garray *x, long n)
+{
+	(void)x;
+	(void)n;
+}
+
+void garray_redraw(t_garray *x)
+{
+	(void)x;
+}
+
+/*
+	Atoms
+*/
+t_float atom_getfloat(const t_atom *a)
+{
+	return(a->a_type == A_FLOAT ? a->a_w.w_float : 0);
+}
+
+t_symbol *atom_getsymbol(const t_atom *a)
+{
+	return(a->a_type == A_SYMBOL ? a->a_w.w_symbol : gensym("float"));
+}
+
+t_float atom_getfloatarg(int which, int argc, const t_atom *argv)
+{
+	return(which < argc ? atom_getfloat(&argv[which]) : 0);
+}
+
+t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv)
+{
+	return(which < argc && argv[which].a_type == A_SYMBOL ? argv[which].a_w.w_symbol : gensym(""));
+}
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+	(void)f;
+	(void)n;
+}
+
+/*
+	Canvases: files are relative to the working directory
+*/
+t_canvas *canvas_getcurrent(void)
+{
+	return(NULL);
+}
+
+void canvas_makefilename(const t_canvas *c, const char *file, char *result, int resultsize)
+{
+	(void)c;
+	snprintf(result, resultsize, "%s", file);
+}
@@ -0,0 +1,37 @@
+/*
+	Stub Pd runtime for the benchmark: memory, symbols, outlets
+	and a scheduler that advances logical time in DSP ticks
+	against the wall clock, running clocks as they come due,
+	like Pd's scheduler does between audio blocks
+*/
+#ifndef SENSEL_BENCH_PD_STUB_H
+#define SENSEL_BENCH_PD_STUB_H
+
+#include <stdatomic.h>
+#include "m_pd.h"
+
+/*
+	What the runtime saw, for the benchmark to report
+*/
+typedef struct _stub_counts
+{
+	atomic_ullong c_allocations;	// getbytes() and resizebytes() calls, from any thread
+	unsigned long long c_lists;		// lists output
+	unsigned long long c_messages;	// other messages output
+	unsigned long long c_atoms;		// atoms in both
+	unsigned long long c_errors;
+} t_stub_counts;
+
+extern t_stub_counts stub_counts;
+
+/*
+	Runs the scheduler for msec of wall clock time
+*/
+void stub_sched_run(double msec);
+
+/*
+	Frees an object made with pd_new() after its free method ran
+*/
+void stub_pd_free(void *x);
+
+#endif
@@ -0,0 +1,152 @@
+/*
+	Micro-benchmark of the poll -> ring -> outlet pipeline: runs
+	[sensel] objects on simulated devices against the stub Pd
+	runtime and prints one JSON line per combination of device
+	and contact count, with the contacts output per second, the
+	memory allocations per frame and the distribution of the
+	time from reading a frame to its output.
+
+	sensel_bench [-t seconds] [-r frames-per-second]
+
+	The external is included whole, so the benchmark sees its
+	static functions and state as they are.
+*/
+#include "../sensel.c"
+#include "pd_stub.h"
+
+#define BENCH_MAX_DEVICES		16
+#define BENCH_CONNECT_MSEC		2000.0
+#define BENCH_WARMUP_MSEC		200.0
+
+static const int bench_devices[] = { 1, 4, 16 };
+static const int bench_contacts[] = { 1, 4, 16 };
+
+/*
+	Runs the scheduler until every object is (dis)connected,
+	returning:
+		0 for success
+		-1 on timeout
+*/
+static int bench_wait_connected(t_sensel **x, int n, int connected)
+{
+	for (double waited = 0; waited < BENCH_CONNECT_MSEC; waited += 10)
+	{
+		int i;
+
+		for (i = 0; i < n; i++)
+			if (x[i]->x_connected != connected)
+				break;
+		if (i == n)
+			return(0);
+		stub_sched_run(10);
+	}
+	return(-1);
+}
+
+static void bench_run(int devices, int contacts, double seconds, int rate)
+{
+	t_sensel *x[BENCH_MAX_DEVICES];
+	unsigned int frames[BENCH_MAX_DEVICES], overflow[BENCH_MAX_DEVICES];
+	t_sensel_histogram latency;
+	unsigned long long total_frames = 0, total_overflow = 0;
+	char name[64];
+	int i, b;
+
+	for (i = 0; i < devices; i++)
+	{
+		x[i] = (t_sensel *)sensel_new();
+		sensel_set_sim(x[i], gensym("contacts"), contacts);
+		sensel_set_sim(x[i], gensym("rate"), rate);
+		sensel_set_mode(x[i], gensym("event"));
+		sensel_set_poll_wait_time(x[i], 1);
+		snprintf(name, sizeof(name), "%sstill.%d", SENSEL_SIM_PREFIX, i);
+		sensel_connect(x[i], gensym(name));
+	}
+	if (bench_wait_connected(x, devices, 1) < 0)
+	{
+		fprintf(stderr, "sensel_bench: %d devices did not connect\n", devices);
+		exit(1);
+	}
+	stub_sched_run(BENCH_WARMUP_MSEC);
+
+	for (i = 0; i < devices; i++)
+	{
+		frames[i] = atomic_load(&x[i]->x_thread_stats.s_frames);
+		overflow[i] = atomic_load(&x[i]->x_ring.r_overflow);
+		sensel_histogram_reset(&x[i]->x_stats_latency);
+	}
+	unsigned long long lists = stub_counts.c_lists;
+	unsigned long long allocations = atomic_load(&stub_counts.c_allocations);
+	unsigned long long start = sensel_monotonic_usec();
+
+	stub_sched_run(seconds * 1000.0);
+
+	double elapsed = (double)(sensel_monotonic_usec() - start) / 1000000.0;
+	allocations = atomic_load(&stub_counts.c_allocations) - allocations;
+	lists = stub_counts.c_lists - lists;
+
+	// one histogram over all devices
+	sensel_histogram_reset(&latency);
+	for (i = 0; i < devices; i++)
+	{
+		total_frames += atomic_load(&x[i]->x_thread_stats.s_frames) - frames[i];
+		total_overflow += atomic_load(&x[i]->x_ring.r_overflow) - overflow[i];
+		for (b = 0; b < SENSEL_HISTOGRAM_BUCKETS; b++)
+		{
+			atomic_fetch_add(&latency.h_counts[b], atomic_load(&x[i]->x_stats_latency.h_counts[b]));
+		}
+		if (atomic_load(&x[i]->x_stats_latency.h_max) > atomic_load(&latency.h_max))
+			atomic_store(&latency.h_max, atomic_load(&x[i]->x_stats_latency.h_max));
+	}
+	unsigned int p50, p99, max;
+	sensel_histogram_summary(&latency, &p50, &p99, &max);
+
+	printf("{\"devices\": %d, \"contacts\": %d, \"rate\": %d, \"seconds\": %.3f, "
+		"\"frames_per_second\": %.1f, \"contacts_per_second\": %.1f, "
+		"\"allocations_per_frame\": %.4f, \"overflow\": %llu, "
+		"\"latency_ms\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}}\n",
+		devices, contacts, rate, elapsed,
+		total_frames / elapsed, lists / elapsed,
+		(total_frames > 0 ? (double)allocations / total_frames : 0.0), total_overflow,
+		p50 / 1000.0, p99 / 1000.0, max / 1000.0);
+	fflush(stdout);
+
+	for (i = 0; i < devices; i++)
+		sensel_disconnect(x[i]);
+	bench_wait_connected(x, devices, 0);
+	for (i = 0; i < devices; i++)
+	{
+		sensel_free(x[i]);
+		stub_pd_free(x[i]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = 2;
+	int rate = 1000;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (!strcmp(argv[i], "-t"))
+			seconds = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "-r"))
+			rate = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "usage: sensel_bench [-t seconds] [-r frames-per-second]\n");
+			return(1);
+		}
+	}
+	if (seconds <= 0 || rate < 1)
+	{
+		fprintf(stderr, "sensel_bench: seconds and rate must be positive\n");
+		return(1);
+	}
+
+	sensel_setup();
+	for (unsigned int d = 0; d < sizeof(bench_devices) / sizeof(bench_devices[0]); d++)
+		for (unsigned int c = 0; c < sizeof(bench_contacts) / sizeof(bench_contacts[0]); c++)
+			bench_run(bench_devices[d], bench_contacts[c], seconds, rate);
+	return(0);
+}
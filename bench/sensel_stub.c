@@ -0,0 +1,135 @@
+#include <string.h>
+#include "sensel.h"
+
+/*
+	Stub LibSensel: there is never a Morph attached, so the
+	benchmark only ever runs simulated devices
+*/
+SenselStatus WINAPI senselGetDeviceList(SenselDeviceList *list)
+{
+	memset(list, 0, sizeof(SenselDeviceList));
+	return(SENSEL_OK);
+}
+
+SenselStatus WINAPI senselOpenDeviceByID(SENSEL_HANDLE *handle, unsigned char idx)
+{
+	(void)handle;
+	(void)idx;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselOpenDeviceBySerialNum(SENSEL_HANDLE *handle, unsigned char *serial_num)
+{
+	(void)handle;
+	(void)serial_num;
+	return(SENSEL_ERROR);
+}
+
+/*
+	Nothing is ever opened, so none of these can be reached
+*/
+SenselStatus WINAPI senselClose(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselGetSensorInfo(SENSEL_HANDLE handle, SenselSensorInfo *info)
+{
+	(void)handle;
+	(void)info;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselAllocateFrameData(SENSEL_HANDLE handle, SenselFrameData **data)
+{
+	(void)handle;
+	(void)data;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselFreeFrameData(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	(void)handle;
+	(void)data;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselSetFrameContent(SENSEL_HANDLE handle, unsigned char content)
+{
+	(void)handle;
+	(void)content;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselSetContactsMask(SENSEL_HANDLE handle, unsigned char mask)
+{
+	(void)handle;
+	(void)mask;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselSetScanMode(SENSEL_HANDLE handle, SenselScanMode mode)
+{
+	(void)handle;
+	(void)mode;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselStartScanning(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselStopScanning(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselReadSensor(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselGetNumAvailableFrames(SENSEL_HANDLE handle, unsigned int *num_avail_frames)
+{
+	(void)handle;
+	*num_avail_frames = 0;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselGetFrame(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	(void)handle;
+	(void)data;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselSetLEDBrightness(SENSEL_HANDLE handle, unsigned char led_id, unsigned short brightness)
+{
+	(void)handle;
+	(void)led_id;
+	(void)brightness;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselGetMaxLEDBrightness(SENSEL_HANDLE handle, unsigned short *max_brightness)
+{
+	(void)handle;
+	(void)max_brightness;
+	return(SENSEL_ERROR);
+}
+
+SenselStatus WINAPI senselWriteRegVS(SENSEL_HANDLE handle, unsigned char reg, unsigned int size,
+	unsigned char *buf, unsigned int *write_size)
+{
+	(void)handle;
+	(void)reg;
+	(void)size;
+	(void)buf;
+	*write_size = 0;
+	return(SENSEL_ERROR);
+}
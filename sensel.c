@@ -5,6 +5,8 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <math.h>
 #include "sensel.h"
 #include "sensel_device.h"
 
@@ -17,6 +19,14 @@
 #else
 	#include <pthread.h>
 	#include <time.h>
+	#include <poll.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#ifndef M_PI
+	#define M_PI 3.14159265358979323846
 #endif
 
 /*
@@ -54,520 +64,6971 @@
 static t_class *sensel_class;
 
 /*
-	Single-linked list for accumulating data output
+	Output record types stored in the ring buffer
+*/
+#define SENSEL_RECORD_CONTACT	0	// contact data (20 args)
+#define SENSEL_RECORD_CONTACTS	1	// number of contacts (only one arg)
+#define SENSEL_RECORD_FRAME		2	// contact count, then the selected fields of each contact
+#define SENSEL_RECORD_TIME		3	// host usec the following frame is due at and was read at
+								// (two 32-bit halves each)
+#define SENSEL_RECORD_GESTURE	4	// SENSEL_GESTURE_*, then its values
+#define SENSEL_RECORD_ACCEL		5	// accelerometer x, y and z
+#define SENSEL_RECORD_BLOB		6	// contact id, then SENSEL_BLOB_FIELDS of its blob
+#define SENSEL_RECORD_SKIP		0xffff	// padding up to the end of the ring
+
+/*
+	Output formats: one list per contact (plus the contact count
+	when it changes) or one "frame" message per frame holding
+	only the selected fields of every contact
+*/
+#define SENSEL_FORMAT_CONTACTS	0
+#define SENSEL_FORMAT_FRAME		1
+
+/*
+	The 20 contact fields, in the order of a contact list, each
+	selected by its bit in a field mask
 */
-typedef struct _data
+#define SENSEL_FIELDS			20
+#define SENSEL_FIELDS_ALL		((1 << SENSEL_FIELDS) - 1)
+#define SENSEL_FIELDS_ELLIPSE	((1 << 2) | (1 << 3) | (1 << 4))
+#define SENSEL_FIELDS_DELTAS	((1 << 5) | (1 << 6) | (1 << 7) | (1 << 8))
+#define SENSEL_FIELDS_BOX		((1 << 9) | (1 << 10) | (1 << 11) | (1 << 12))
+#define SENSEL_FIELDS_PEAK		((1 << 13) | (1 << 14) | (1 << 15))
+
+static const char *sensel_field_names[SENSEL_FIELDS] =
 {
-	t_atom args[20];
-	int type;	// 0 = data (20 args)
-				// 1 = number of contacts (only one arg)
-	struct _data *next;
-} t_data;
+	"id", "state", "orientation", "major", "minor",
+	"dx", "dy", "dforce", "darea",
+	"minx", "miny", "maxx", "maxy",
+	"peakx", "peaky", "peakforce",
+	"x", "y", "force", "area",
+};
 
 /*
-	An array keeping track of which devices are
-	already connected up to maximum allowed by
-	the sensel API
+	The optional contact data groups the device has to send
+	for a field mask (id, state, position, force and area are
+	always sent)
 */
-static t_symbol sensel_connected_devices[SENSEL_MAX_DEVICES];
+static unsigned char sensel_contacts_mask(int fields)
+{
+	unsigned char mask = 0;
+
+	if (fields & SENSEL_FIELDS_ELLIPSE)
+		mask |= CONTACT_MASK_ELLIPSE;
+	if (fields & SENSEL_FIELDS_DELTAS)
+		mask |= CONTACT_MASK_DELTAS;
+	if (fields & SENSEL_FIELDS_BOX)
+		mask |= CONTACT_MASK_BOUNDING_BOX;
+	if (fields & SENSEL_FIELDS_PEAK)
+		mask |= CONTACT_MASK_PEAK;
+	return(mask);
+}
 
 /*
-	Adds a device to the list of connected devices,
-	returning:
-		0 for success
-		-1 for failure (shouldn't happen as API should throw error first)
+	Ways the thread can wait for new data between reads
+*/
+#define SENSEL_MODE_POLL		0	// sleep for the poll time
+#define SENSEL_MODE_EVENT		1	// wake as soon as the device has data
+
+// number of full frames the ring can hold before it overflows
+#define SENSEL_RING_FRAMES		32
+
+/*
+	One slot of the output ring, either a record header
+	(type in the upper, argument count in the lower 16 bits)
+	or one of the record's float arguments
 */
-static int add_connected_to_sensel_device_list(t_symbol *s)
+typedef union _sensel_slot
 {
-	int i = 0;
+	unsigned int s_header;
+	float s_float;
+} t_sensel_slot;
+
+/*
+	Preallocated single-producer/single-consumer ring of output
+	records. The worker thread is its only writer and the output
+	clock its only reader, so neither side needs a mutex or an
+	allocation. Records are written in place and published a
+	whole frame at a time by advancing r_write, so the reader
+	never sees a partially written frame.
+*/
+typedef struct _sensel_ring
+{
+	t_sensel_slot *r_slots;
+	unsigned int r_size;		// always a power of two
+	atomic_uint r_read;			// owned by the reader
+	atomic_uint r_write;		// owned by the writer
+	unsigned int r_pending;		// writer's uncommitted position
+	int r_failed;				// current frame did not fit
+	atomic_uint r_overflow;		// number of dropped frames
+} t_sensel_ring;
+
+/*
+	Allocates the ring with room for at least n slots
+*/
+static void sensel_ring_alloc(t_sensel_ring *r, unsigned int n)
+{
+	unsigned int size = 64;
+	while (size < n)
+		size <<= 1;
+	r->r_slots = (t_sensel_slot *)getbytes(size * sizeof(t_sensel_slot));
+	r->r_size = size;
+	atomic_store(&r->r_read, 0);
+	atomic_store(&r->r_write, 0);
+	r->r_pending = 0;
+	r->r_failed = 0;
+	atomic_store(&r->r_overflow, 0);
+}
 
-	while (i < SENSEL_MAX_DEVICES)
+/*
+	Frees the ring's storage
+*/
+static void sensel_ring_free(t_sensel_ring *r)
+{
+	if (r->r_slots != NULL)
 	{
-		if (sensel_connected_devices[i].s_name == NULL)
-		{
-			sensel_connected_devices[i] = *s;
-			return(0);
-		}
-		else
-			i++;
+		freebytes(r->r_slots, r->r_size * sizeof(t_sensel_slot));
+		r->r_slots = NULL;
+		r->r_size = 0;
 	}
-	return(-1);
 }
 
 /*
-	Removes device from the list of connected devices,
-	returning:
-		0 for success
-		-1 for failure (shouldn't happen as API should throw error first)
+	Writer side: reserves a record of argc arguments in the
+	current frame and returns a pointer to its arguments, or
+	NULL if the ring is full (the whole frame is then dropped
+	on commit). Records never wrap around the end of the ring,
+	so the arguments are always contiguous.
 */
-static int remove_connected_to_sensel_device_list(t_symbol *s)
+static t_sensel_slot *sensel_ring_push(t_sensel_ring *r, int type, int argc)
 {
-	int i = 0;
+	if (r->r_failed)
+		return(NULL);
+
+	unsigned int read = atomic_load_explicit(&r->r_read, memory_order_acquire);
+	unsigned int need = argc + 1;
+	unsigned int offset = r->r_pending & (r->r_size - 1);
+	unsigned int pad = 0;
 
-	while (i < SENSEL_MAX_DEVICES)
+	if (offset + need > r->r_size)
+		pad = r->r_size - offset;
+
+	if (r->r_pending - read + pad + need > r->r_size)
 	{
-		if (sensel_connected_devices[i].s_name != NULL)
-		{
-			if (!strcmp(sensel_connected_devices[i].s_name, s->s_name))
-			{
-				sensel_connected_devices[i].s_name = NULL;
-				return(0);
-			}
-			i++;
-		}
+		r->r_failed = 1;
+		return(NULL);
 	}
-	return(-1);
+
+	if (pad)
+	{
+		r->r_slots[offset].s_header = (SENSEL_RECORD_SKIP << 16) | (pad - 1);
+		r->r_pending += pad;
+		offset = 0;
+	}
+
+	r->r_slots[offset].s_header = (type << 16) | argc;
+	r->r_pending += need;
+	return(&r->r_slots[offset + 1]);
 }
 
 /*
-	Checks if a device we wish to connect is already
-	on the list of connected devices, returns:
-		1 for yes
-		0 for no
-*/ 
-static int check_if_already_on_sensel_device_list(t_symbol *s)
+	Writer side: publishes all records pushed since the last
+	commit, or drops them and counts an overflow if they did
+	not fit
+*/
+static void sensel_ring_commit(t_sensel_ring *r)
 {
-	int i = 0;
+	if (r->r_failed)
+	{
+		r->r_pending = atomic_load_explicit(&r->r_write, memory_order_relaxed);
+		r->r_failed = 0;
+		atomic_fetch_add_explicit(&r->r_overflow, 1, memory_order_relaxed);
+	}
+	else
+		atomic_store_explicit(&r->r_write, r->r_pending, memory_order_release);
+}
+
+/*
+	Writer side: drops the records pushed since the last commit,
+	without counting them as an overflow
+*/
+static void sensel_ring_discard(t_sensel_ring *r)
+{
+	r->r_pending = atomic_load_explicit(&r->r_write, memory_order_relaxed);
+	r->r_failed = 0;
+}
+
+/*
+	Reader side: the end of what has been published so far
+*/
+static unsigned int sensel_ring_published(t_sensel_ring *r)
+{
+	return(atomic_load_explicit(&r->r_write, memory_order_acquire));
+}
 
-	while (i < SENSEL_MAX_DEVICES)
+/*
+	Reader side: returns the next record's arguments (and its
+	type and argument count) or NULL if there is none before
+	end, as returned by sensel_ring_published(). The record
+	stays valid until sensel_ring_pop().
+*/
+static t_sensel_slot *sensel_ring_peek(t_sensel_ring *r, unsigned int end, int *type, int *argc)
+{
+	unsigned int read = atomic_load_explicit(&r->r_read, memory_order_relaxed);
+
+	while (read != end)
 	{
-		if (sensel_connected_devices[i].s_name != NULL)
+		unsigned int offset = read & (r->r_size - 1);
+		unsigned int header = r->r_slots[offset].s_header;
+		if ((header >> 16) != SENSEL_RECORD_SKIP)
 		{
-			if (!strcmp(sensel_connected_devices[i].s_name, s->s_name))
-				return(1);
+			*type = header >> 16;
+			*argc = header & 0xffff;
+			return(&r->r_slots[offset + 1]);
 		}
-		i++;
+		read += (header & 0xffff) + 1;
+		atomic_store_explicit(&r->r_read, read, memory_order_release);
 	}
+	return(NULL);
+}
+
+/*
+	Reader side: releases the record returned by sensel_ring_peek()
+*/
+static void sensel_ring_pop(t_sensel_ring *r, int argc)
+{
+	unsigned int read = atomic_load_explicit(&r->r_read, memory_order_relaxed);
+	atomic_store_explicit(&r->r_read, read + argc + 1, memory_order_release);
+}
+
+/*
+	Generic single-producer/single-consumer queue of fixed-size
+	items, used to pass commands from the Pd thread to the Sensel
+	thread and replies back, without either side ever waiting
+	on the other
+*/
+typedef struct _sensel_queue
+{
+	char *q_items;
+	unsigned int q_itemsize;
+	unsigned int q_size;		// always a power of two
+	atomic_uint q_read;			// owned by the consumer
+	atomic_uint q_write;		// owned by the producer
+} t_sensel_queue;
+
+/*
+	Allocates a queue of n items (n must be a power of two)
+*/
+static void sensel_queue_alloc(t_sensel_queue *q, unsigned int itemsize, unsigned int n)
+{
+	q->q_items = (char *)getbytes(n * itemsize);
+	q->q_itemsize = itemsize;
+	q->q_size = n;
+	atomic_init(&q->q_read, 0);
+	atomic_init(&q->q_write, 0);
+}
+
+/*
+	Frees the queue's storage
+*/
+static void sensel_queue_free(t_sensel_queue *q)
+{
+	freebytes(q->q_items, q->q_size * q->q_itemsize);
+	q->q_items = NULL;
+}
+
+/*
+	Producer side: copies an item into the queue, returning:
+		0 for success
+		-1 if the queue is full
+*/
+static int sensel_queue_push(t_sensel_queue *q, const void *item)
+{
+	unsigned int write = atomic_load_explicit(&q->q_write, memory_order_relaxed);
+	unsigned int read = atomic_load_explicit(&q->q_read, memory_order_acquire);
+
+	if (write - read >= q->q_size)
+		return(-1);
+	memcpy(q->q_items + (write & (q->q_size - 1)) * q->q_itemsize, item, q->q_itemsize);
+	atomic_store_explicit(&q->q_write, write + 1, memory_order_release);
 	return(0);
 }
 
 /*
-	Main Sensel Morph data structure
+	Consumer side: copies the oldest item out of the queue, returning:
+		0 for success
+		-1 if the queue is empty
 */
-typedef struct _sensel
+static int sensel_queue_pop(t_sensel_queue *q, void *item)
 {
-	t_object x_obj;
-	t_atom x_atom;
-	t_canvas *x_canvas;
+	unsigned int read = atomic_load_explicit(&q->q_read, memory_order_relaxed);
+	unsigned int write = atomic_load_explicit(&q->q_write, memory_order_acquire);
 
-	t_outlet *x_outlet_data;
-	t_outlet *x_outlet_status;
+	if (read == write)
+		return(-1);
+	memcpy(item, q->q_items + (read & (q->q_size - 1)) * q->q_itemsize, q->q_itemsize);
+	atomic_store_explicit(&q->q_read, read + 1, memory_order_release);
+	return(0);
+}
 
-	SENSEL_HANDLE x_handle;
-	SenselFrameData *x_frame;
-	int x_connected;
-	int x_thread_connected;
+/*
+	Consumer side: whether there is nothing left to pop
+*/
+static int sensel_queue_empty(t_sensel_queue *q)
+{
+	return(atomic_load_explicit(&q->q_read, memory_order_relaxed)
+		== atomic_load_explicit(&q->q_write, memory_order_acquire));
+}
 
-	pthread_t x_unsafe_t;
-	pthread_mutex_t x_unsafe_mutex;
-	int x_unsafe;
-	t_data *x_data;
-	t_data *x_data_end;
-	int x_n_contacts;
-	int x_poll_wait;
+/*
+	Force image processing kernels. Every stage has a scalar
+	version and, on x86, SSE and AVX2 versions compiled for
+	their instruction set only, so the external still loads on
+	any CPU; sensel_kernels_select() picks the widest one the
+	CPU supports when the class is set up. All kernels work on
+	unaligned row-major rows x cols images.
+*/
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#define SENSEL_SIMD_X86
+	#include <immintrin.h>
+#endif
 
-	short unsigned int x_led[24];
-	short unsigned int x_thread_led[24];
+#define SENSEL_BLUR_MAX_RADIUS		8
 
-	t_clock *x_clock_output;
-    int x_clock_set;
+typedef struct _sensel_kernels
+{
+	const char *k_name;
+	void (*k_gain)(float *out, const float *in, int n, float gain);
+	void (*k_threshold)(float *data, int n, float threshold);
+	void (*k_smooth)(float *state, const float *in, int n, float weight);
+	void (*k_blur_rows)(float *out, const float *in, int rows, int cols, const float *weights, int radius);
+	void (*k_blur_cols)(float *out, const float *in, int rows, int cols, const float *weights, int radius);
+	void (*k_sum_rows)(float *out, const float *in, int rows, int cols);
+	void (*k_sum_cols)(float *out, const float *in, int rows, int cols);
+} t_sensel_kernels;
 
-	t_symbol *x_serial;
+static void sensel_gain_scalar(float *out, const float *in, int n, float gain)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = in[i] * gain;
+}
 
-} t_sensel;
+/*
+	Zeroes every value below the threshold
+*/
+static void sensel_threshold_scalar(float *data, int n, float threshold)
+{
+	for (int i = 0; i < n; i++)
+		if (data[i] < threshold)
+			data[i] = 0;
+}
 
 /*
-	Struct for passing args to the Sensel thread
+	Exponential smoothing over time: moves the state towards
+	the new frame by weight (1 follows the frame exactly)
 */
-typedef struct _threadedFunctionParams
+static void sensel_smooth_scalar(float *state, const float *in, int n, float weight)
 {
-	t_sensel *s_inst;
-} t_threadedFunctionParams;
+	for (int i = 0; i < n; i++)
+		state[i] += (in[i] - state[i]) * weight;
+}
 
 /*
-	Forward declarations
+	One horizontal blur tap sum for cell c of a row, with the
+	edge cells repeated beyond the border
 */
-static void sensel_poll(t_sensel *x);
+static float sensel_blur_cell(const float *row, int cols, int c, const float *weights, int radius)
+{
+	float sum = 0;
+
+	for (int k = -radius; k <= radius; k++)
+	{
+		int i = c + k;
+		i = (i < 0 ? 0 : (i >= cols ? cols - 1 : i));
+		sum += row[i] * weights[k + radius];
+	}
+	return(sum);
+}
+
+static void sensel_blur_rows_scalar(float *out, const float *in, int rows, int cols, const float *weights, int radius)
+{
+	for (int r = 0; r < rows; r++)
+		for (int c = 0; c < cols; c++)
+			out[r * cols + c] = sensel_blur_cell(in + r * cols, cols, c, weights, radius);
+}
+
+static void sensel_blur_cols_scalar(float *out, const float *in, int rows, int cols, const float *weights, int radius)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		float *dst = out + r * cols;
+
+		for (int c = 0; c < cols; c++)
+			dst[c] = 0;
+		for (int k = -radius; k <= radius; k++)
+		{
+			int i = r + k;
+			const float *src = in + (i < 0 ? 0 : (i >= rows ? rows - 1 : i)) * cols;
+			float w = weights[k + radius];
+
+			for (int c = 0; c < cols; c++)
+				dst[c] += src[c] * w;
+		}
+	}
+}
+
+static void sensel_sum_rows_scalar(float *out, const float *in, int rows, int cols)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		float sum = 0;
+		for (int c = 0; c < cols; c++)
+			sum += in[r * cols + c];
+		out[r] = sum;
+	}
+}
+
+static void sensel_sum_cols_scalar(float *out, const float *in, int rows, int cols)
+{
+	for (int c = 0; c < cols; c++)
+		out[c] = 0;
+	for (int r = 0; r < rows; r++)
+		for (int c = 0; c < cols; c++)
+			out[c] += in[r * cols + c];
+}
+
+static const t_sensel_kernels sensel_kernels_scalar =
+{
+	"scalar",
+	sensel_gain_scalar,
+	sensel_threshold_scalar,
+	sensel_smooth_scalar,
+	sensel_blur_rows_scalar,
+	sensel_blur_cols_scalar,
+	sensel_sum_rows_scalar,
+	sensel_sum_cols_scalar,
+};
+
+#ifdef SENSEL_SIMD_X86
 
 /*
-	Allows adjustment of the wait time
-	in between poll reads from the Sensel socket
+	SSE kernels, 4 floats at a time
 */
-static void sensel_set_poll_wait_time(t_sensel *x, t_floatarg f)
+__attribute__((target("sse2")))
+static void sensel_gain_sse(float *out, const float *in, int n, float gain)
 {
-	if (f < 1.0 || f > 100.0)
+	__m128 g = _mm_set1_ps(gain);
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+	sensel_gain_scalar(out + i, in + i, n - i, gain);
+}
+
+__attribute__((target("sse2")))
+static void sensel_threshold_sse(float *data, int n, float threshold)
+{
+	__m128 t = _mm_set1_ps(threshold);
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4)
 	{
-		error("sensel: poll time must be between 1 and 100ms (default 10ms).");
-		return;
+		__m128 v = _mm_loadu_ps(data + i);
+		_mm_storeu_ps(data + i, _mm_and_ps(v, _mm_cmpge_ps(v, t)));
+	}
+	sensel_threshold_scalar(data + i, n - i, threshold);
+}
+
+__attribute__((target("sse2")))
+static void sensel_smooth_sse(float *state, const float *in, int n, float weight)
+{
+	__m128 w = _mm_set1_ps(weight);
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 s = _mm_loadu_ps(state + i);
+		s = _mm_add_ps(s, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i), s), w));
+		_mm_storeu_ps(state + i, s);
+	}
+	sensel_smooth_scalar(state + i, in + i, n - i, weight);
+}
+
+__attribute__((target("sse2")))
+static void sensel_blur_rows_sse(float *out, const float *in, int rows, int cols, const float *weights, int radius)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		const float *row = in + r * cols;
+		float *dst = out + r * cols;
+		int c = 0;
+
+		// the cells near the edges need clamping
+		for (; c < radius && c < cols; c++)
+			dst[c] = sensel_blur_cell(row, cols, c, weights, radius);
+		for (; c + 4 + radius <= cols; c += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int k = -radius; k <= radius; k++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + c + k), _mm_set1_ps(weights[k + radius])));
+			_mm_storeu_ps(dst + c, sum);
+		}
+		for (; c < cols; c++)
+			dst[c] = sensel_blur_cell(row, cols, c, weights, radius);
+	}
+}
+
+__attribute__((target("sse2")))
+static void sensel_blur_cols_sse(float *out, const float *in, int rows, int cols, const float *weights, int radius)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		float *dst = out + r * cols;
+		int c = 0;
+
+		for (; c + 4 <= cols; c += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int k = -radius; k <= radius; k++)
+			{
+				int i = r + k;
+				const float *src = in + (i < 0 ? 0 : (i >= rows ? rows - 1 : i)) * cols;
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + c), _mm_set1_ps(weights[k + radius])));
+			}
+			_mm_storeu_ps(dst + c, sum);
+		}
+		for (; c < cols; c++)
+		{
+			float sum = 0;
+			for (int k = -radius; k <= radius; k++)
+			{
+				int i = r + k;
+				sum += in[(i < 0 ? 0 : (i >= rows ? rows - 1 : i)) * cols + c] * weights[k + radius];
+			}
+			dst[c] = sum;
+		}
+	}
+}
+
+__attribute__((target("sse2")))
+static void sensel_sum_rows_sse(float *out, const float *in, int rows, int cols)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		const float *row = in + r * cols;
+		__m128 acc = _mm_setzero_ps();
+		float lanes[4], sum;
+		int c = 0;
+
+		for (; c + 4 <= cols; c += 4)
+			acc = _mm_add_ps(acc, _mm_loadu_ps(row + c));
+		_mm_storeu_ps(lanes, acc);
+		sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		for (; c < cols; c++)
+			sum += row[c];
+		out[r] = sum;
+	}
+}
+
+__attribute__((target("sse2")))
+static void sensel_sum_cols_sse(float *out, const float *in, int rows, int cols)
+{
+	int c = 0;
+
+	for (; c + 4 <= cols; c += 4)
+	{
+		__m128 acc = _mm_setzero_ps();
+		for (int r = 0; r < rows; r++)
+			acc = _mm_add_ps(acc, _mm_loadu_ps(in + r * cols + c));
+		_mm_storeu_ps(out + c, acc);
+	}
+	for (; c < cols; c++)
+	{
+		float sum = 0;
+		for (int r = 0; r < rows; r++)
+			sum += in[r * cols + c];
+		out[c] = sum;
+	}
+}
+
+static const t_sensel_kernels sensel_kernels_sse =
+{
+	"SSE",
+	sensel_gain_sse,
+	sensel_threshold_sse,
+	sensel_smooth_sse,
+	sensel_blur_rows_sse,
+	sensel_blur_cols_sse,
+	sensel_sum_rows_sse,
+	sensel_sum_cols_sse,
+};
+
+/*
+	AVX2 kernels, 8 floats at a time
+*/
+__attribute__((target("avx2")))
+static void sensel_gain_avx2(float *out, const float *in, int n, float gain)
+{
+	__m256 g = _mm256_set1_ps(gain);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+	sensel_gain_scalar(out + i, in + i, n - i, gain);
+}
+
+__attribute__((target("avx2")))
+static void sensel_threshold_avx2(float *data, int n, float threshold)
+{
+	__m256 t = _mm256_set1_ps(threshold);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 v = _mm256_loadu_ps(data + i);
+		_mm256_storeu_ps(data + i, _mm256_and_ps(v, _mm256_cmp_ps(v, t, _CMP_GE_OQ)));
+	}
+	sensel_threshold_scalar(data + i, n - i, threshold);
+}
+
+__attribute__((target("avx2")))
+static void sensel_smooth_avx2(float *state, const float *in, int n, float weight)
+{
+	__m256 w = _mm256_set1_ps(weight);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 s = _mm256_loadu_ps(state + i);
+		s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), s), w));
+		_mm256_storeu_ps(state + i, s);
+	}
+	sensel_smooth_scalar(state + i, in + i, n - i, weight);
+}
+
+__attribute__((target("avx2")))
+static void sensel_blur_rows_avx2(float *out, const float *in, int rows, int cols, const float *weights, int radius)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		const float *row = in + r * cols;
+		float *dst = out + r * cols;
+		int c = 0;
+
+		for (; c < radius && c < cols; c++)
+			dst[c] = sensel_blur_cell(row, cols, c, weights, radius);
+		for (; c + 8 + radius <= cols; c += 8)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			for (int k = -radius; k <= radius; k++)
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(row + c + k), _mm256_set1_ps(weights[k + radius])));
+			_mm256_storeu_ps(dst + c, sum);
+		}
+		for (; c < cols; c++)
+			dst[c] = sensel_blur_cell(row, cols, c, weights, radius);
+	}
+}
+
+__attribute__((target("avx2")))
+static void sensel_blur_cols_avx2(float *out, const float *in, int rows, int cols, const float *weights, int radius)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		float *dst = out + r * cols;
+		int c = 0;
+
+		for (; c + 8 <= cols; c += 8)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			for (int k = -radius; k <= radius; k++)
+			{
+				int i = r + k;
+				const float *src = in + (i < 0 ? 0 : (i >= rows ? rows - 1 : i)) * cols;
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(src + c), _mm256_set1_ps(weights[k + radius])));
+			}
+			_mm256_storeu_ps(dst + c, sum);
+		}
+		for (; c < cols; c++)
+		{
+			float sum = 0;
+			for (int k = -radius; k <= radius; k++)
+			{
+				int i = r + k;
+				sum += in[(i < 0 ? 0 : (i >= rows ? rows - 1 : i)) * cols + c] * weights[k + radius];
+			}
+			dst[c] = sum;
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void sensel_sum_rows_avx2(float *out, const float *in, int rows, int cols)
+{
+	for (int r = 0; r < rows; r++)
+	{
+		const float *row = in + r * cols;
+		__m256 acc = _mm256_setzero_ps();
+		float lanes[8], sum = 0;
+		int c = 0;
+
+		for (; c + 8 <= cols; c += 8)
+			acc = _mm256_add_ps(acc, _mm256_loadu_ps(row + c));
+		_mm256_storeu_ps(lanes, acc);
+		for (int i = 0; i < 8; i++)
+			sum += lanes[i];
+		for (; c < cols; c++)
+			sum += row[c];
+		out[r] = sum;
+	}
+}
+
+__attribute__((target("avx2")))
+static void sensel_sum_cols_avx2(float *out, const float *in, int rows, int cols)
+{
+	int c = 0;
+
+	for (; c + 8 <= cols; c += 8)
+	{
+		__m256 acc = _mm256_setzero_ps();
+		for (int r = 0; r < rows; r++)
+			acc = _mm256_add_ps(acc, _mm256_loadu_ps(in + r * cols + c));
+		_mm256_storeu_ps(out + c, acc);
+	}
+	for (; c < cols; c++)
+	{
+		float sum = 0;
+		for (int r = 0; r < rows; r++)
+			sum += in[r * cols + c];
+		out[c] = sum;
+	}
+}
+
+static const t_sensel_kernels sensel_kernels_avx2 =
+{
+	"AVX2",
+	sensel_gain_avx2,
+	sensel_threshold_avx2,
+	sensel_smooth_avx2,
+	sensel_blur_rows_avx2,
+	sensel_blur_cols_avx2,
+	sensel_sum_rows_avx2,
+	sensel_sum_cols_avx2,
+};
+
+#endif // SENSEL_SIMD_X86
+
+static const t_sensel_kernels *sensel_kernels = &sensel_kernels_scalar;
+
+/*
+	Picks the widest kernels the CPU runs
+*/
+static void sensel_kernels_select(void)
+{
+#ifdef SENSEL_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		sensel_kernels = &sensel_kernels_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		sensel_kernels = &sensel_kernels_sse;
+#endif
+}
+
+/*
+	Sensel thread side processing of the force image, applied
+	to every frame with force data (or only to the latest one
+	when there is no temporal smoothing) before it is rendered
+	or reduced for the Pd thread
+*/
+#define SENSEL_IMAGE_GAIN			0	// multiply by value
+#define SENSEL_IMAGE_THRESHOLD		1	// zero cells below value
+#define SENSEL_IMAGE_BLUR			2	// gaussian blur, sigma in cells
+#define SENSEL_IMAGE_SMOOTH			3	// temporal smoothing amount (0-1)
+#define SENSEL_IMAGE_ROWS			4	// reduce to row sums (0/1)
+#define SENSEL_IMAGE_COLS			5	// reduce to column sums (0/1)
+#define SENSEL_IMAGE_RESET			6	// all stages off
+
+#define SENSEL_BLUR_MAX_SIGMA		3.0f
+
+typedef struct _sensel_process
+{
+	float p_gain;
+	float p_threshold;
+	float p_smooth;			// weight of the newest frame, 1 = off
+	int p_radius;			// blur radius, 0 = off
+	float p_weights[2 * SENSEL_BLUR_MAX_RADIUS + 1];
+	int p_rows;
+	int p_cols;
+
+	float *p_work;
+	float *p_temp;
+	float *p_state;			// smoothed image
+	int p_state_valid;
+	int p_cells;
+} t_sensel_process;
+
+static void sensel_process_set(t_sensel_process *p, int param, float value)
+{
+	switch (param)
+	{
+		case SENSEL_IMAGE_GAIN:
+			p->p_gain = value;
+			break;
+		case SENSEL_IMAGE_THRESHOLD:
+			p->p_threshold = value;
+			break;
+		case SENSEL_IMAGE_BLUR:
+		{
+			float sum = 0;
+
+			p->p_radius = (value > 0 ? (int)ceilf(2.5f * value) : 0);
+			if (p->p_radius > SENSEL_BLUR_MAX_RADIUS)
+				p->p_radius = SENSEL_BLUR_MAX_RADIUS;
+			for (int k = -p->p_radius; k <= p->p_radius; k++)
+				sum += (p->p_weights[k + p->p_radius] = expf(-(k * k) / (2 * value * value)));
+			for (int k = 0; k <= 2 * p->p_radius; k++)
+				p->p_weights[k] /= sum;
+			break;
+		}
+		case SENSEL_IMAGE_SMOOTH:
+			p->p_smooth = 1 - value;
+			p->p_state_valid = 0;
+			break;
+		case SENSEL_IMAGE_ROWS:
+			p->p_rows = (value != 0);
+			break;
+		case SENSEL_IMAGE_COLS:
+			p->p_cols = (value != 0);
+			break;
+		case SENSEL_IMAGE_RESET:
+			p->p_gain = 1;
+			p->p_threshold = 0;
+			p->p_smooth = 1;
+			p->p_radius = 0;
+			p->p_rows = 0;
+			p->p_cols = 0;
+			break;
+	}
+}
+
+static void sensel_process_alloc(t_sensel_process *p, int cells)
+{
+	p->p_cells = cells;
+	p->p_work = (float *)getbytes(cells * sizeof(float));
+	p->p_temp = (float *)getbytes(cells * sizeof(float));
+	p->p_state = (float *)getbytes(cells * sizeof(float));
+	p->p_state_valid = 0;
+}
+
+static void sensel_process_free(t_sensel_process *p)
+{
+	if (p->p_work != NULL)
+	{
+		freebytes(p->p_work, p->p_cells * sizeof(float));
+		freebytes(p->p_temp, p->p_cells * sizeof(float));
+		freebytes(p->p_state, p->p_cells * sizeof(float));
+	}
+	p->p_work = p->p_temp = p->p_state = NULL;
+	p->p_cells = 0;
+}
+
+/*
+	Runs the enabled stages over a force image, returning the
+	processed image (force itself if no stage is enabled)
+*/
+static const float *sensel_process_frame(t_sensel_process *p, const float *force, int rows, int cols)
+{
+	const float *image = force;
+	int n = rows * cols;
+
+	if (n > p->p_cells)
+		return(force);
+	if (p->p_gain != 1 || p->p_threshold > 0)
+	{
+		sensel_kernels->k_gain(p->p_work, image, n, p->p_gain);
+		image = p->p_work;
+		if (p->p_threshold > 0)
+			sensel_kernels->k_threshold(p->p_work, n, p->p_threshold);
+	}
+	if (p->p_radius > 0)
+	{
+		sensel_kernels->k_blur_rows(p->p_temp, image, rows, cols, p->p_weights, p->p_radius);
+		sensel_kernels->k_blur_cols(p->p_work, p->p_temp, rows, cols, p->p_weights, p->p_radius);
+		image = p->p_work;
+	}
+	if (p->p_smooth < 1)
+	{
+		if (p->p_state_valid)
+			sensel_kernels->k_smooth(p->p_state, image, n, p->p_smooth);
+		else
+			memcpy(p->p_state, image, n * sizeof(float));
+		p->p_state_valid = 1;
+		image = p->p_state;
+	}
+	return(image);
+}
+
+/*
+	Double-buffered force image. The Sensel thread renders the
+	latest frame into the back buffer as t_words, so that the
+	Pd thread can copy it into a garray's storage with a single
+	memcpy, and swaps buffers only once the Pd thread is done
+	with the front one (a newer frame simply overwrites the
+	back buffer in the meantime). Each buffer also holds the
+	row and column sums of the image, if asked for.
+*/
+#define SENSEL_PRESSURE_MAX_FACTOR	16
+
+typedef struct _sensel_image
+{
+	t_word *i_data[2];
+	t_word *i_sums[2];		// row sums followed by column sums
+	int i_rows[2];			// size of the image, 0 x 0 if not rendered
+	int i_cols[2];
+	int i_row_sums[2];		// number of row sums, 0 if not reduced
+	int i_col_sums[2];
+	int i_cells;			// capacity of each buffer
+	int i_lines;			// capacity of each sums buffer
+	float *i_scratch;		// Sensel thread side sums
+	int i_back;				// owned by the Sensel thread while i_full is 0
+	int i_pending;			// Sensel thread side: back buffer holds a new image
+	atomic_int i_full;		// front buffer holds an image for the Pd thread
+} t_sensel_image;
+
+static void sensel_image_alloc(t_sensel_image *img, int rows, int cols)
+{
+	img->i_cells = rows * cols;
+	img->i_lines = rows + cols;
+	for (int i = 0; i < 2; i++)
+	{
+		img->i_data[i] = (t_word *)getbytes(img->i_cells * sizeof(t_word));
+		img->i_sums[i] = (t_word *)getbytes(img->i_lines * sizeof(t_word));
+		img->i_rows[i] = img->i_cols[i] = 0;
+		img->i_row_sums[i] = img->i_col_sums[i] = 0;
+	}
+	img->i_scratch = (float *)getbytes(img->i_lines * sizeof(float));
+	img->i_back = 0;
+	img->i_pending = 0;
+	atomic_init(&img->i_full, 0);
+}
+
+static void sensel_image_free(t_sensel_image *img)
+{
+	if (img->i_data[0] != NULL)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			freebytes(img->i_data[i], img->i_cells * sizeof(t_word));
+			freebytes(img->i_sums[i], img->i_lines * sizeof(t_word));
+		}
+		freebytes(img->i_scratch, img->i_lines * sizeof(float));
+	}
+	img->i_data[0] = img->i_data[1] = NULL;
+	img->i_cells = 0;
+	img->i_lines = 0;
+}
+
+/*
+	Producer side: renders a rows x cols force image into the
+	back buffer, averaging factor x factor blocks of cells (0
+	skips the image), and reduces it to row and column sums if
+	asked to
+*/
+static void sensel_image_render(t_sensel_image *img, const float *force, int rows, int cols,
+	int factor, int row_sums, int col_sums)
+{
+	int back = img->i_back;
+	t_word *out = img->i_data[back];
+	int out_rows = 0, out_cols = 0;
+
+	if (rows * cols > img->i_cells || rows + cols > img->i_lines)
+		return;
+	if (factor == 1)
+	{
+		out_rows = rows;
+		out_cols = cols;
+		for (int i = 0; i < rows * cols; i++)
+			out[i].w_float = force[i];
+	}
+	else if (factor > 1)
+	{
+		float scale = 1.0f / (factor * factor);
+
+		out_rows = rows / factor;
+		out_cols = cols / factor;
+		for (int r = 0; r < out_rows; r++)
+		{
+			for (int c = 0; c < out_cols; c++)
+			{
+				const float *block = force + r * factor * cols + c * factor;
+				float sum = 0;
+
+				for (int i = 0; i < factor; i++)
+					for (int j = 0; j < factor; j++)
+						sum += block[i * cols + j];
+				out[r * out_cols + c].w_float = sum * scale;
+			}
+		}
+	}
+	img->i_rows[back] = out_rows;
+	img->i_cols[back] = out_cols;
+
+	img->i_row_sums[back] = (row_sums ? rows : 0);
+	img->i_col_sums[back] = (col_sums ? cols : 0);
+	if (row_sums)
+		sensel_kernels->k_sum_rows(img->i_scratch, force, rows, cols);
+	if (col_sums)
+		sensel_kernels->k_sum_cols(img->i_scratch + img->i_row_sums[back], force, rows, cols);
+	for (int i = 0; i < img->i_row_sums[back] + img->i_col_sums[back]; i++)
+		img->i_sums[back][i].w_float = img->i_scratch[i];
+	img->i_pending = 1;
+}
+
+/*
+	Producer side: hands a rendered image over, returning:
+		1 if the Pd thread has a new image to output
+		0 if there is nothing new or the front buffer is still busy
+*/
+static int sensel_image_publish(t_sensel_image *img)
+{
+	if (!img->i_pending || atomic_load_explicit(&img->i_full, memory_order_acquire))
+		return(0);
+	img->i_back ^= 1;
+	img->i_pending = 0;
+	atomic_store_explicit(&img->i_full, 1, memory_order_release);
+	return(1);
+}
+
+/*
+	Commands sent from the Pd thread to the Sensel thread
+*/
+#define SENSEL_COMMAND_CONNECT		0	// open device c_text
+#define SENSEL_COMMAND_DISCOVER		1	// open first available device
+#define SENSEL_COMMAND_START		2	// output is ready, start scanning
+#define SENSEL_COMMAND_DISCONNECT	3	// stop scanning and close device
+#define SENSEL_COMMAND_IDENTIFY		4	// list available devices
+#define SENSEL_COMMAND_LED			5	// LED c_value (-1 = all) to brightness c_value2 in c_float msec
+#define SENSEL_COMMAND_POLL			6	// poll time in usec
+#define SENSEL_COMMAND_MODE			7	// SENSEL_MODE_*
+#define SENSEL_COMMAND_SIM			8	// simulation parameter c_value to c_value2
+#define SENSEL_COMMAND_RECORD		9	// record to t_sensel_recorder c_pointer
+#define SENSEL_COMMAND_STOP			10	// stop recording
+#define SENSEL_COMMAND_REPLAY		11	// replay file c_pointer at speed c_float
+#define SENSEL_COMMAND_SEEK			12	// seek replay to c_value msec
+#define SENSEL_COMMAND_PRESSURE		13	// force image downsampled by c_value (0 = off)
+#define SENSEL_COMMAND_IMAGE		14	// force image SENSEL_IMAGE_* c_value to c_float
+#define SENSEL_COMMAND_FORMAT		15	// SENSEL_FORMAT_* c_value
+#define SENSEL_COMMAND_FIELDS		16	// contact field mask c_value
+#define SENSEL_COMMAND_STATS		17	// reset the statistics
+#define SENSEL_COMMAND_ZONES		18	// zone table c_pointer, NULL for none
+#define SENSEL_COMMAND_DEADBAND		19	// deadband SENSEL_DEADBAND_* c_value to c_float
+#define SENSEL_COMMAND_FILTER		20	// contact filter SENSEL_FILTER_* c_value to c_float
+#define SENSEL_COMMAND_GESTURES		21	// gestures on (1) or off (0) c_value
+#define SENSEL_COMMAND_LED_SEGMENT	22	// then on to brightness c_value2 in c_float msec
+#define SENSEL_COMMAND_LED_RATE		23	// LED writes at most every c_value usec
+#define SENSEL_COMMAND_ACCEL		24	// accelerometer averaged over c_value frames (0 = off),
+									// output on changes of c_float
+#define SENSEL_COMMAND_BLOBS		25	// blob statistics on (1) or off (0) c_value
+#define SENSEL_COMMAND_HOTPLUG		26	// reopen unplugged devices (1) or not (0) c_value,
+									// also the watcher's own reopening of device c_text
+
+#define SENSEL_COMMAND_QUEUE_SIZE	256
+
+#define SENSEL_ACCEL_MAX_FRAMES		1000
+
+typedef struct _sensel_command
+{
+	int c_type;
+	int c_value;
+	int c_value2;
+	float c_float;
+	void *c_pointer;
+	char c_text[64];
+} t_sensel_command;
+
+/*
+	Replies sent from the Sensel thread back to the Pd thread
+*/
+#define SENSEL_REPLY_CONNECTED		0	// device r_text opened, r_value max contacts
+#define SENSEL_REPLY_DISCONNECTED	1	// device closed, r_value 1 at the end of a replay,
+									// 2 when device r_text was unplugged
+#define SENSEL_REPLY_ERROR			2	// r_command failed with SENSEL_ERROR_*
+#define SENSEL_REPLY_IDENTIFY		3	// r_value devices found
+#define SENSEL_REPLY_DEVICE			4	// device number r_value is r_text
+#define SENSEL_REPLY_RECORDED		5	// recording stopped, r_value frames, r_value2 dropped,
+									// r_value3 1 if writing the file failed
+
+#define SENSEL_ERROR_NO_DEVICE		0	// no devices at all
+#define SENSEL_ERROR_NOT_FOUND		1	// requested device did not open
+#define SENSEL_ERROR_IN_USE			2	// requested device is taken
+#define SENSEL_ERROR_ALL_IN_USE		3	// every device is taken
+#define SENSEL_ERROR_BAD_FILE		4	// recording r_text could not be read
+
+#define SENSEL_REPLY_QUEUE_SIZE		64
+
+typedef struct _sensel_reply
+{
+	int r_type;
+	int r_command;
+	int r_value;
+	int r_value2;
+	int r_value3;
+	char r_text[64];
+} t_sensel_reply;
+
+/*
+	Monotonic time in microseconds, used for frame pacing
+*/
+static unsigned long long sensel_monotonic_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/*
+	Histogram of durations in usec, with four buckets per power
+	of two (exact below 4 usec), so percentiles come out within
+	25% of the true value from a fixed block of counters. It has
+	a single writer at a time; the counters are atomic only so
+	that another thread can read them while it writes, which
+	never needs more than a roughly consistent picture.
+*/
+#define SENSEL_HISTOGRAM_BUCKETS	124
+
+typedef struct _sensel_histogram
+{
+	atomic_uint h_counts[SENSEL_HISTOGRAM_BUCKETS];
+	atomic_uint h_max;
+} t_sensel_histogram;
+
+static void sensel_histogram_reset(t_sensel_histogram *h)
+{
+	for (int i = 0; i < SENSEL_HISTOGRAM_BUCKETS; i++)
+		atomic_store_explicit(&h->h_counts[i], 0, memory_order_relaxed);
+	atomic_store_explicit(&h->h_max, 0, memory_order_relaxed);
+}
+
+static int sensel_histogram_bucket(unsigned int usec)
+{
+	int e;
+
+	if (usec < 4)
+		return(usec);
+	for (e = 2; (usec >> (e + 1)) != 0; e++)
+		;
+	return(4 * (e - 1) + ((usec >> (e - 2)) & 3));
+}
+
+/*
+	Smallest duration that falls into a bucket
+*/
+static unsigned int sensel_histogram_floor(int bucket)
+{
+	if (bucket < 4)
+		return(bucket);
+	return((unsigned int)(4 + bucket % 4) << (bucket / 4 - 1));
+}
+
+/*
+	Writer side: counts one duration
+*/
+static void sensel_histogram_add(t_sensel_histogram *h, unsigned long long usec)
+{
+	unsigned int v = (usec > 0xffffffffULL ? 0xffffffffU : (unsigned int)usec);
+	atomic_uint *count = &h->h_counts[sensel_histogram_bucket(v)];
+
+	atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1,
+		memory_order_relaxed);
+	if (v > atomic_load_explicit(&h->h_max, memory_order_relaxed))
+		atomic_store_explicit(&h->h_max, v, memory_order_relaxed);
+}
+
+/*
+	Reader side: the p50, p99 and largest durations counted, in
+	usec (the upper end of the percentiles' buckets), returning
+	the number of durations counted
+*/
+static unsigned int sensel_histogram_summary(t_sensel_histogram *h, unsigned int *p50,
+	unsigned int *p99, unsigned int *max)
+{
+	unsigned int counts[SENSEL_HISTOGRAM_BUCKETS], total = 0, seen = 0;
+	int i;
+
+	*max = atomic_load_explicit(&h->h_max, memory_order_relaxed);
+	for (i = 0; i < SENSEL_HISTOGRAM_BUCKETS; i++)
+		total += (counts[i] = atomic_load_explicit(&h->h_counts[i], memory_order_relaxed));
+	*p50 = *p99 = 0;
+	for (i = 0; i < SENSEL_HISTOGRAM_BUCKETS && seen < total; i++)
+	{
+		unsigned int top = (i + 1 < SENSEL_HISTOGRAM_BUCKETS ?
+			sensel_histogram_floor(i + 1) - 1 : 0xffffffffU);
+
+		if (top > *max)
+			top = *max;
+		seen += counts[i];
+		if (*p50 == 0 && seen * 2ULL >= total)
+			*p50 = top;
+		if (seen * 100ULL >= total * 99ULL)
+		{
+			*p99 = top;
+			break;
+		}
+	}
+	return(total);
+}
+
+/*
+	Counters kept by the Sensel thread for the "stats" message
+*/
+typedef struct _sensel_stats
+{
+	atomic_uint s_frames;			// frames read
+	atomic_uint s_contacts;			// contacts in those frames
+	atomic_uint s_max_contacts;		// most contacts in a frame
+	atomic_uint s_lost;				// frames the device reported lost
+	atomic_uint s_ring_high;		// most output ring slots in use
+	t_sensel_histogram s_read;		// usec spent reading the sensor
+} t_sensel_stats;
+
+static void sensel_stats_reset(t_sensel_stats *s)
+{
+	atomic_store_explicit(&s->s_frames, 0, memory_order_relaxed);
+	atomic_store_explicit(&s->s_contacts, 0, memory_order_relaxed);
+	atomic_store_explicit(&s->s_max_contacts, 0, memory_order_relaxed);
+	atomic_store_explicit(&s->s_lost, 0, memory_order_relaxed);
+	atomic_store_explicit(&s->s_ring_high, 0, memory_order_relaxed);
+	sensel_histogram_reset(&s->s_read);
+}
+
+/*
+	Writer side: adds n to a counter, or raises it to n if max
+*/
+static void sensel_stats_count(atomic_uint *counter, unsigned int n, int max)
+{
+	unsigned int value = atomic_load_explicit(counter, memory_order_relaxed);
+
+	if (!max)
+		atomic_store_explicit(counter, value + n, memory_order_relaxed);
+	else if (n > value)
+		atomic_store_explicit(counter, n, memory_order_relaxed);
+}
+
+#define SENSEL_LEDS				24
+
+/*
+	Device backend, mirroring the parts of the Sensel API the
+	external uses, so that the Sensel thread can drive a real
+	Morph or a simulated one through the same calls. Every
+	call takes the backend's own device handle.
+*/
+typedef struct _sensel_backend
+{
+	const char *b_name;
+	SenselStatus (*b_close)(SENSEL_HANDLE handle);
+	SenselStatus (*b_get_sensor_info)(SENSEL_HANDLE handle, SenselSensorInfo *info);
+	SenselStatus (*b_set_frame_content)(SENSEL_HANDLE handle, unsigned char content);
+	SenselStatus (*b_set_contacts_mask)(SENSEL_HANDLE handle, unsigned char mask);
+	SenselStatus (*b_allocate_frame_data)(SENSEL_HANDLE handle, SenselFrameData **data);
+	SenselStatus (*b_free_frame_data)(SENSEL_HANDLE handle, SenselFrameData *data);
+	SenselStatus (*b_set_scan_mode)(SENSEL_HANDLE handle, SenselScanMode mode);
+	SenselStatus (*b_start_scanning)(SENSEL_HANDLE handle);
+	SenselStatus (*b_stop_scanning)(SENSEL_HANDLE handle);
+	SenselStatus (*b_read_sensor)(SENSEL_HANDLE handle);
+	SenselStatus (*b_get_num_available_frames)(SENSEL_HANDLE handle, unsigned int *num_frames);
+	SenselStatus (*b_get_frame)(SENSEL_HANDLE handle, SenselFrameData *data);
+	// sets the brightness of all n LEDs at once
+	SenselStatus (*b_set_leds)(SENSEL_HANDLE handle, const unsigned short *brightness, int n);
+	SenselStatus (*b_get_max_led_brightness)(SENSEL_HANDLE handle, unsigned short *max_brightness);
+	// pollable descriptor that becomes readable with new data, or -1
+	int (*b_get_fd)(SENSEL_HANDLE handle);
+	// usec until the next frame is due, or -1 if unknown
+	int (*b_next_frame_usec)(SENSEL_HANDLE handle);
+	// changes a backend specific parameter
+	SenselStatus (*b_configure)(SENSEL_HANDLE handle, int param, int value);
+	// a finite source (a replayed recording) has run out of frames
+	int (*b_finished)(SENSEL_HANDLE handle);
+	// device timestamp (usec, wrapping) of the latest frame read
+	SenselStatus (*b_get_timestamp)(SENSEL_HANDLE handle, unsigned int *timestamp);
+} t_sensel_backend;
+
+/*
+	Allocates a frame with room for everything a sensor
+	can report, like senselAllocateFrameData() does
+*/
+static SenselFrameData *sensel_frame_data_new(const SenselSensorInfo *info)
+{
+	int cells = info->num_rows * info->num_cols;
+	SenselFrameData *frame = (SenselFrameData *)getbytes(sizeof(SenselFrameData));
+
+	frame->contacts = (SenselContact *)getbytes(info->max_contacts * sizeof(SenselContact));
+	frame->force_array = (float *)getbytes(cells * sizeof(float));
+	frame->labels_array = (unsigned char *)getbytes(cells);
+	frame->accel_data = (SenselAccelData *)getbytes(sizeof(SenselAccelData));
+	return(frame);
+}
+
+static void sensel_frame_data_free(const SenselSensorInfo *info, SenselFrameData *frame)
+{
+	int cells = info->num_rows * info->num_cols;
+
+	freebytes(frame->contacts, info->max_contacts * sizeof(SenselContact));
+	freebytes(frame->force_array, cells * sizeof(float));
+	freebytes(frame->labels_array, cells);
+	freebytes(frame->accel_data, sizeof(SenselAccelData));
+	freebytes(frame, sizeof(SenselFrameData));
+}
+
+/*
+	Vendor backend: thin wrappers around LibSensel
+*/
+static SenselStatus sensel_vendor_close(SENSEL_HANDLE handle)
+{
+	return(senselClose(handle));
+}
+
+static SenselStatus sensel_vendor_get_sensor_info(SENSEL_HANDLE handle, SenselSensorInfo *info)
+{
+	return(senselGetSensorInfo(handle, info));
+}
+
+static SenselStatus sensel_vendor_set_frame_content(SENSEL_HANDLE handle, unsigned char content)
+{
+	return(senselSetFrameContent(handle, content));
+}
+
+static SenselStatus sensel_vendor_set_contacts_mask(SENSEL_HANDLE handle, unsigned char mask)
+{
+	return(senselSetContactsMask(handle, mask));
+}
+
+static SenselStatus sensel_vendor_allocate_frame_data(SENSEL_HANDLE handle, SenselFrameData **data)
+{
+	return(senselAllocateFrameData(handle, data));
+}
+
+static SenselStatus sensel_vendor_free_frame_data(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	return(senselFreeFrameData(handle, data));
+}
+
+static SenselStatus sensel_vendor_set_scan_mode(SENSEL_HANDLE handle, SenselScanMode mode)
+{
+	return(senselSetScanMode(handle, mode));
+}
+
+static SenselStatus sensel_vendor_start_scanning(SENSEL_HANDLE handle)
+{
+	return(senselStartScanning(handle));
+}
+
+static SenselStatus sensel_vendor_stop_scanning(SENSEL_HANDLE handle)
+{
+	return(senselStopScanning(handle));
+}
+
+static SenselStatus sensel_vendor_read_sensor(SENSEL_HANDLE handle)
+{
+	return(senselReadSensor(handle));
+}
+
+static SenselStatus sensel_vendor_get_num_available_frames(SENSEL_HANDLE handle, unsigned int *num_frames)
+{
+	return(senselGetNumAvailableFrames(handle, num_frames));
+}
+
+static SenselStatus sensel_vendor_get_frame(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	return(senselGetFrame(handle, data));
+}
+
+static SenselStatus sensel_vendor_get_max_led_brightness(SENSEL_HANDLE handle, unsigned short *max_brightness)
+{
+	return(senselGetMaxLEDBrightness(handle, max_brightness));
+}
+
+/*
+	The library writes the whole LED register for every LED set,
+	so all of them are written in one transfer here instead,
+	through the library's own copy of the register so that it
+	stays in step. Devices without one are set LED by LED.
+*/
+#define SENSEL_REG_LED_BRIGHTNESS	0x80	// from LibSensel's register map
+
+static SenselStatus sensel_vendor_set_leds(SENSEL_HANDLE handle, const unsigned short *brightness, int n)
+{
+	SenselDevice *device = (SenselDevice *)handle;
+	unsigned int written;
+	int i;
+
+	if (device->led_array == NULL || (device->led_reg_size != 1 && device->led_reg_size != 2))
+	{
+		for (i = 0; i < n; i++)
+			if (senselSetLEDBrightness(handle, i, brightness[i]) != SENSEL_OK)
+				return(SENSEL_ERROR);
+		return(SENSEL_OK);
+	}
+	if (n > device->num_leds)
+		n = device->num_leds;
+	for (i = 0; i < n; i++)
+	{
+		if (device->led_reg_size == 1)
+			((unsigned char *)device->led_array)[i] = (unsigned char)brightness[i];
+		else
+			((unsigned short *)device->led_array)[i] = brightness[i];
+	}
+	return(senselWriteRegVS(handle, SENSEL_REG_LED_BRIGHTNESS, device->num_leds * device->led_reg_size,
+		(unsigned char *)device->led_array, &written));
+}
+
+static int sensel_vendor_get_fd(SENSEL_HANDLE handle)
+{
+#ifdef WIN32
+	(void)handle;
+	return(-1);
+#else
+	return(((SenselDevice *)handle)->sensor_serial.serial_fd);
+#endif
+}
+
+static int sensel_vendor_next_frame_usec(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(-1);
+}
+
+static SenselStatus sensel_vendor_configure(SENSEL_HANDLE handle, int param, int value)
+{
+	(void)handle;
+	(void)param;
+	(void)value;
+	return(SENSEL_ERROR);
+}
+
+static int sensel_vendor_finished(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(0);
+}
+
+static SenselStatus sensel_vendor_get_timestamp(SENSEL_HANDLE handle, unsigned int *timestamp)
+{
+	// the library keeps the timestamp of the last frame it parsed
+	*timestamp = ((SenselDevice *)handle)->prev_timestamp;
+	return(SENSEL_OK);
+}
+
+static const t_sensel_backend sensel_vendor_backend =
+{
+	"sensel",
+	sensel_vendor_close,
+	sensel_vendor_get_sensor_info,
+	sensel_vendor_set_frame_content,
+	sensel_vendor_set_contacts_mask,
+	sensel_vendor_allocate_frame_data,
+	sensel_vendor_free_frame_data,
+	sensel_vendor_set_scan_mode,
+	sensel_vendor_start_scanning,
+	sensel_vendor_stop_scanning,
+	sensel_vendor_read_sensor,
+	sensel_vendor_get_num_available_frames,
+	sensel_vendor_get_frame,
+	sensel_vendor_set_leds,
+	sensel_vendor_get_max_led_brightness,
+	sensel_vendor_get_fd,
+	sensel_vendor_next_frame_usec,
+	sensel_vendor_configure,
+	sensel_vendor_finished,
+	sensel_vendor_get_timestamp,
+};
+
+/*
+	Simulated backend: a synthetic Morph that plays a gesture
+	script with a configurable number of contacts at a
+	configurable frame rate, including force and label images
+	and accelerometer data when the frame content asks for them.
+	Selected with "connect sim:<script>" (optionally followed
+	by ".<tag>" to run the same script on several objects).
+*/
+#define SENSEL_SIM_PREFIX			"sim:"
+#define SENSEL_SIM_ROWS				105
+#define SENSEL_SIM_COLS				185
+#define SENSEL_SIM_WIDTH			240.0f
+#define SENSEL_SIM_HEIGHT			139.0f
+#define SENSEL_SIM_MIN_CONTACTS		16
+#define SENSEL_SIM_MAX_CONTACTS		254	// ids (and labels) stay below SENSEL_NULL_LABEL
+#define SENSEL_SIM_BUFFERED_FRAMES	64	// more pending frames are lost
+#define SENSEL_SIM_MAX_LED			100		// brightest an LED gets, as on the Morph
+
+#define SENSEL_SIM_STILL			0	// contacts resting in a grid
+#define SENSEL_SIM_TAP				1	// staggered short taps
+#define SENSEL_SIM_SWIPE			2	// left to right strokes
+#define SENSEL_SIM_CIRCLE			3	// contacts circling the center
+#define SENSEL_SIM_PINCH			4	// contacts spreading and closing
+#define SENSEL_SIM_RANDOM			5	// random walk, random lift-offs
+
+static const char *sensel_sim_scripts[] =
+{
+	"still", "tap", "swipe", "circle", "pinch", "random", NULL
+};
+
+/*
+	Simulation parameters, changed with the "sim" message
+*/
+#define SENSEL_SIM_PARAM_CONTACTS	0
+#define SENSEL_SIM_PARAM_RATE		1
+#define SENSEL_SIM_PARAM_NOISE		2
+#define SENSEL_SIM_PARAM_SEED		3
+#define SENSEL_SIM_PARAM_SKEW		4
+
+typedef struct _sensel_sim_config
+{
+	int c_contacts;			// number of simulated contacts
+	int c_rate;				// frames per second
+	int c_noise;			// force image noise in grams
+	unsigned int c_seed;	// random seed, for repeatable runs
+	int c_skew;				// device clock error in parts per million
+} t_sensel_sim_config;
+
+typedef struct _sensel_sim
+{
+	t_sensel_sim_config s_config;
+	int s_script;
+	SenselSensorInfo s_info;
+	unsigned char s_content;
+	unsigned char s_contacts_mask;
+	int s_scanning;
+	unsigned long long s_last_read;	// usec of the last read
+	double s_credit;				// fraction of the next frame elapsed
+	unsigned int s_pending;			// frames ready to be fetched
+	int s_lost;						// frames lost since the last frame
+	double s_time;					// script time of the next frame
+	double s_stamp;					// device timestamp of the latest frame
+	unsigned int s_random;
+	unsigned char s_down[256];		// contact was down in the last frame
+	float s_x[256];					// last position, force and area
+	float s_y[256];
+	float s_force[256];
+	float s_area[256];
+	unsigned short s_led[SENSEL_LEDS];	// as last written
+} t_sensel_sim;
+
+/*
+	xorshift, so that runs with the same seed are identical
+*/
+static float sensel_sim_random(t_sensel_sim *sim)
+{
+	unsigned int r = sim->s_random;
+	r ^= r << 13;
+	r ^= r >> 17;
+	r ^= r << 5;
+	sim->s_random = r;
+	return((float)(r & 0xffffff) / (float)0x1000000);
+}
+
+static SenselStatus sensel_sim_open(SENSEL_HANDLE *handle, const char *name,
+	const t_sensel_sim_config *config)
+{
+	char script[64];
+	int i;
+
+	if (strncmp(name, SENSEL_SIM_PREFIX, strlen(SENSEL_SIM_PREFIX)))
+		return(SENSEL_ERROR);
+	strncpy(script, name + strlen(SENSEL_SIM_PREFIX), 63);
+	script[63] = '\0';
+	if (strchr(script, '.'))
+		*strchr(script, '.') = '\0';
+
+	for (i = 0; sensel_sim_scripts[i] != NULL; i++)
+	{
+		if (!strcmp(script, sensel_sim_scripts[i]))
+			break;
+	}
+	if (sensel_sim_scripts[i] == NULL)
+		return(SENSEL_ERROR);
+
+	t_sensel_sim *sim = (t_sensel_sim *)getbytes(sizeof(t_sensel_sim));
+	sim->s_config = *config;
+	sim->s_script = i;
+	sim->s_info.max_contacts = (config->c_contacts > SENSEL_SIM_MIN_CONTACTS ?
+		config->c_contacts : SENSEL_SIM_MIN_CONTACTS);
+	sim->s_info.num_rows = SENSEL_SIM_ROWS;
+	sim->s_info.num_cols = SENSEL_SIM_COLS;
+	sim->s_info.width = SENSEL_SIM_WIDTH;
+	sim->s_info.height = SENSEL_SIM_HEIGHT;
+	sim->s_content = FRAME_CONTENT_CONTACTS_MASK;
+	sim->s_contacts_mask = CONTACT_MASK_ELLIPSE | CONTACT_MASK_DELTAS |
+		CONTACT_MASK_BOUNDING_BOX | CONTACT_MASK_PEAK;
+	sim->s_random = (config->c_seed ? config->c_seed : 1);
+	*handle = sim;
+	return(SENSEL_OK);
+}
+
+/*
+	Applies a "sim" parameter change to a simulation config
+*/
+static void sensel_sim_set_param(t_sensel_sim_config *config, int param, int value)
+{
+	switch (param)
+	{
+		case SENSEL_SIM_PARAM_CONTACTS:
+			config->c_contacts = (value < 0 ? 0
+				: (value > SENSEL_SIM_MAX_CONTACTS ? SENSEL_SIM_MAX_CONTACTS : value));
+			break;
+		case SENSEL_SIM_PARAM_RATE:
+			config->c_rate = (value < 1 ? 1 : value);
+			break;
+		case SENSEL_SIM_PARAM_NOISE:
+			config->c_noise = (value < 0 ? 0 : value);
+			break;
+		case SENSEL_SIM_PARAM_SEED:
+			config->c_seed = (unsigned int)value;
+			break;
+		case SENSEL_SIM_PARAM_SKEW:
+			config->c_skew = (value < -1000 ? -1000 : (value > 1000 ? 1000 : value));
+			break;
+	}
+}
+
+static SenselStatus sensel_sim_close(SENSEL_HANDLE handle)
+{
+	freebytes(handle, sizeof(t_sensel_sim));
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_get_sensor_info(SENSEL_HANDLE handle, SenselSensorInfo *info)
+{
+	*info = ((t_sensel_sim *)handle)->s_info;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_set_frame_content(SENSEL_HANDLE handle, unsigned char content)
+{
+	((t_sensel_sim *)handle)->s_content = content;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_set_contacts_mask(SENSEL_HANDLE handle, unsigned char mask)
+{
+	((t_sensel_sim *)handle)->s_contacts_mask = mask;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_allocate_frame_data(SENSEL_HANDLE handle, SenselFrameData **data)
+{
+	*data = sensel_frame_data_new(&((t_sensel_sim *)handle)->s_info);
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_free_frame_data(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	sensel_frame_data_free(&((t_sensel_sim *)handle)->s_info, data);
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_set_scan_mode(SENSEL_HANDLE handle, SenselScanMode mode)
+{
+	(void)handle;
+	(void)mode;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_start_scanning(SENSEL_HANDLE handle)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+	sim->s_scanning = 1;
+	sim->s_last_read = sensel_monotonic_usec();
+	sim->s_credit = 0;
+	sim->s_pending = 0;
+	sim->s_lost = 0;
+	sim->s_time = 0;
+	sim->s_stamp = 0;
+	memset(sim->s_down, 0, sizeof(sim->s_down));
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_stop_scanning(SENSEL_HANDLE handle)
+{
+	((t_sensel_sim *)handle)->s_scanning = 0;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_read_sensor(SENSEL_HANDLE handle)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+
+	if (sim->s_scanning)
+	{
+		unsigned long long now = sensel_monotonic_usec();
+		sim->s_credit += (double)(now - sim->s_last_read) * sim->s_config.c_rate / 1000000.0;
+		sim->s_last_read = now;
+
+		unsigned int due = (unsigned int)sim->s_credit;
+		sim->s_credit -= due;
+		sim->s_pending += due;
+		// the device stamps frames with its own, slightly off, clock
+		sim->s_stamp += due * (1000000.0 + sim->s_config.c_skew) / sim->s_config.c_rate;
+		// like the device, only a limited number of frames is buffered
+		if (sim->s_pending > SENSEL_SIM_BUFFERED_FRAMES)
+		{
+			sim->s_lost += sim->s_pending - SENSEL_SIM_BUFFERED_FRAMES;
+			sim->s_time += (double)(sim->s_pending - SENSEL_SIM_BUFFERED_FRAMES) / sim->s_config.c_rate;
+			sim->s_pending = SENSEL_SIM_BUFFERED_FRAMES;
+		}
+	}
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_get_num_available_frames(SENSEL_HANDLE handle, unsigned int *num_frames)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+	*num_frames = sim->s_pending;
+	return(SENSEL_OK);
+}
+
+/*
+	Where contact c of n is at time t (in seconds) according to
+	the script, returning whether it touches the surface
+*/
+static int sensel_sim_script(t_sensel_sim *sim, int c, int n, float t,
+	float *x, float *y, float *force)
+{
+	float w = sim->s_info.width, h = sim->s_info.height;
+	float phase = (float)c / (float)n;
+	float gx = w * (0.5f + (c % 4)) / 4.0f;
+	float gy = h * (0.5f + ((c / 4) % 4)) / 4.0f;
+	float a, r;
+
+	switch (sim->s_script)
+	{
+		case SENSEL_SIM_STILL:
+			*x = gx;
+			*y = gy;
+			*force = 200.0f;
+			return(1);
+		case SENSEL_SIM_TAP:
+			a = fmodf(t * 2.0f + phase, 1.0f);
+			*x = gx;
+			*y = gy;
+			*force = 400.0f * sinf((float)M_PI * a / 0.2f);
+			return(a < 0.2f);
+		case SENSEL_SIM_SWIPE:
+			a = fmodf(t + phase * 0.25f, 1.0f);
+			*x = w * (0.1f + a);
+			*y = h * (0.5f + c) / n;
+			*force = 150.0f;
+			return(a < 0.8f);
+		case SENSEL_SIM_CIRCLE:
+			a = 2.0f * (float)M_PI * (t + phase);
+			r = h * (0.15f + 0.3f * phase);
+			*x = w * 0.5f + r * cosf(a);
+			*y = h * 0.5f + r * sinf(a);
+			*force = 200.0f + 100.0f * sinf(a * 3.0f);
+			return(1);
+		case SENSEL_SIM_PINCH:
+			a = 2.0f * (float)M_PI * phase;
+			r = h * (0.1f + 0.3f * (0.5f + 0.5f * sinf(t * (float)M_PI)));
+			*x = w * 0.5f + r * cosf(a);
+			*y = h * 0.5f + r * sinf(a);
+			*force = 250.0f;
+			return(1);
+		case SENSEL_SIM_RANDOM:
+		default:
+			*x = sim->s_x[c] + (sensel_sim_random(sim) - 0.5f) * 4.0f;
+			*y = sim->s_y[c] + (sensel_sim_random(sim) - 0.5f) * 4.0f;
+			if (!sim->s_down[c])
+			{
+				*x = sensel_sim_random(sim) * w;
+				*y = sensel_sim_random(sim) * h;
+			}
+			*x = (*x < 0 ? 0 : (*x > w ? w : *x));
+			*y = (*y < 0 ? 0 : (*y > h ? h : *y));
+			*force = 50.0f + sensel_sim_random(sim) * 400.0f;
+			// toggle about every second
+			if (sensel_sim_random(sim) * sim->s_config.c_rate < 1.0f)
+				return(!sim->s_down[c]);
+			return(sim->s_down[c]);
+	}
+}
+
+/*
+	Adds a contact's force blob (and its label) to the images
+*/
+static void sensel_sim_draw(t_sensel_sim *sim, SenselFrameData *data, int id,
+	float x, float y, float force)
+{
+	int rows = sim->s_info.num_rows, cols = sim->s_info.num_cols;
+	float cx = x / sim->s_info.width * cols;
+	float cy = y / sim->s_info.height * rows;
+	int r, c;
+
+	for (r = (int)cy - 4; r <= (int)cy + 4; r++)
+	{
+		if (r < 0 || r >= rows)
+			continue;
+		for (c = (int)cx - 4; c <= (int)cx + 4; c++)
+		{
+			if (c < 0 || c >= cols)
+				continue;
+			float d2 = (c - cx) * (c - cx) + (r - cy) * (r - cy);
+			float f = force * 0.1f * expf(-d2 / 4.5f);
+			if (sim->s_content & FRAME_CONTENT_PRESSURE_MASK)
+				data->force_array[r * cols + c] += f;
+			if ((sim->s_content & FRAME_CONTENT_LABELS_MASK) && f > 1.0f)
+				data->labels_array[r * cols + c] = id;
+		}
+	}
+}
+
+static SenselStatus sensel_sim_get_frame(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+	int n = sim->s_config.c_contacts, cells = sim->s_info.num_rows * sim->s_info.num_cols;
+	float t = (float)sim->s_time;
+	int c, i;
+
+	if (sim->s_pending == 0)
+		return(SENSEL_ERROR);
+	sim->s_pending--;
+	sim->s_time += 1.0 / sim->s_config.c_rate;
+
+	if (n > sim->s_info.max_contacts)
+		n = sim->s_info.max_contacts;
+
+	data->content_bit_mask = sim->s_content;
+	data->lost_frame_count = sim->s_lost;
+	data->n_contacts = 0;
+	sim->s_lost = 0;
+
+	if (sim->s_content & FRAME_CONTENT_PRESSURE_MASK)
+	{
+		if (sim->s_config.c_noise)
+		{
+			for (i = 0; i < cells; i++)
+				data->force_array[i] = sensel_sim_random(sim) * sim->s_config.c_noise;
+		}
+		else
+			memset(data->force_array, 0, cells * sizeof(float));
+	}
+	if (sim->s_content & FRAME_CONTENT_LABELS_MASK)
+		memset(data->labels_array, SENSEL_NULL_LABEL, cells);
+	if (sim->s_content & FRAME_CONTENT_ACCEL_MASK)
+	{
+		data->accel_data->x = (int)((sensel_sim_random(sim) - 0.5f) * 8.0f);
+		data->accel_data->y = (int)((sensel_sim_random(sim) - 0.5f) * 8.0f);
+		data->accel_data->z = 1000 + (int)((sensel_sim_random(sim) - 0.5f) * 8.0f);
+	}
+
+	for (c = 0; c < sim->s_info.max_contacts; c++)
+	{
+		float x = 0, y = 0, force = 0;
+		int down = (c < n && sensel_sim_script(sim, c, n, t, &x, &y, &force));
+
+		if (!down && !sim->s_down[c])
+			continue;
+
+		SenselContact *contact = &data->contacts[data->n_contacts++];
+		if (!down)
+		{
+			// lift-off is reported where the contact was last seen
+			x = sim->s_x[c];
+			y = sim->s_y[c];
+			force = 0;
+		}
+		float area = (force > 0 ? 10.0f + force / 20.0f : 0);
+
+		contact->content_bit_mask = sim->s_contacts_mask;
+		contact->id = c;
+		contact->state = (!down ? CONTACT_END : (sim->s_down[c] ? CONTACT_MOVE : CONTACT_START));
+		contact->x_pos = x;
+		contact->y_pos = y;
+		contact->total_force = force;
+		contact->area = area;
+		contact->orientation = 0;
+		contact->major_axis = 8.0f;
+		contact->minor_axis = 6.0f;
+		contact->delta_x = (sim->s_down[c] ? x - sim->s_x[c] : 0);
+		contact->delta_y = (sim->s_down[c] ? y - sim->s_y[c] : 0);
+		contact->delta_force = (sim->s_down[c] ? force - sim->s_force[c] : 0);
+		contact->delta_area = (sim->s_down[c] ? area - sim->s_area[c] : 0);
+		contact->min_x = x - 4.0f;
+		contact->min_y = y - 4.0f;
+		contact->max_x = x + 4.0f;
+		contact->max_y = y + 4.0f;
+		contact->peak_x = x;
+		contact->peak_y = y;
+		contact->peak_force = force * 0.1f;
+
+		if (down)
+			sensel_sim_draw(sim, data, c, x, y, force);
+
+		sim->s_down[c] = down;
+		sim->s_x[c] = x;
+		sim->s_y[c] = y;
+		sim->s_force[c] = force;
+		sim->s_area[c] = area;
+	}
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_set_leds(SENSEL_HANDLE handle, const unsigned short *brightness, int n)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+
+	memcpy(sim->s_led, brightness, (n < SENSEL_LEDS ? n : SENSEL_LEDS) * sizeof(unsigned short));
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_sim_get_max_led_brightness(SENSEL_HANDLE handle, unsigned short *max_brightness)
+{
+	(void)handle;
+	*max_brightness = SENSEL_SIM_MAX_LED;
+	return(SENSEL_OK);
+}
+
+static int sensel_sim_get_fd(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(-1);
+}
+
+static int sensel_sim_next_frame_usec(SENSEL_HANDLE handle)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+	double usec = (1.0 - sim->s_credit) * 1000000.0 / sim->s_config.c_rate
+		- (double)(sensel_monotonic_usec() - sim->s_last_read);
+
+	return(usec > 0 ? (int)usec : 0);
+}
+
+static SenselStatus sensel_sim_configure(SENSEL_HANDLE handle, int param, int value)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+
+	sensel_sim_set_param(&sim->s_config, param, value);
+	if (param == SENSEL_SIM_PARAM_SEED)
+		sim->s_random = (value ? (unsigned int)value : 1);
+	return(SENSEL_OK);
+}
+
+static int sensel_sim_finished(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(0);
+}
+
+static SenselStatus sensel_sim_get_timestamp(SENSEL_HANDLE handle, unsigned int *timestamp)
+{
+	t_sensel_sim *sim = (t_sensel_sim *)handle;
+	*timestamp = (unsigned int)(unsigned long long)sim->s_stamp;
+	return(SENSEL_OK);
+}
+
+static const t_sensel_backend sensel_sim_backend =
+{
+	"sim",
+	sensel_sim_close,
+	sensel_sim_get_sensor_info,
+	sensel_sim_set_frame_content,
+	sensel_sim_set_contacts_mask,
+	sensel_sim_allocate_frame_data,
+	sensel_sim_free_frame_data,
+	sensel_sim_set_scan_mode,
+	sensel_sim_start_scanning,
+	sensel_sim_stop_scanning,
+	sensel_sim_read_sensor,
+	sensel_sim_get_num_available_frames,
+	sensel_sim_get_frame,
+	sensel_sim_set_leds,
+	sensel_sim_get_max_led_brightness,
+	sensel_sim_get_fd,
+	sensel_sim_next_frame_usec,
+	sensel_sim_configure,
+	sensel_sim_finished,
+	sensel_sim_get_timestamp,
+};
+
+/*
+	Recordings: raw frames streamed to a compact binary file.
+	A recording starts with SENSEL_RECORDING_MAGIC and an
+	endianness marker, followed by length-prefixed records
+	(a 32-bit length of what follows, then a type byte and the
+	payload). The first record describes the sensor, every
+	further one holds a frame exactly as the device delivered
+	it: host and device time, lost frame count, the contacts
+	(only the field groups each contact carries) and, if the
+	frame content has them, the force and label images and
+	the accelerometer data. Values are stored in host order.
+
+	A recording that was stopped cleanly ends with an index
+	record (the recorded time and file offset of every frame,
+	in order) and a fixed-size trailer record pointing at it,
+	so that a replay can find any frame by time without reading
+	what comes before it. Readers skip record types they do not
+	know, and a recording without a trailer (e.g. cut short by
+	a crash) is indexed by walking its records instead.
+*/
+#define SENSEL_RECORDING_MAGIC		"SNSLREC1"
+#define SENSEL_RECORDING_ENDIAN		0x01020304
+#define SENSEL_RECORDING_SENSOR		0	// record holding the sensor info
+#define SENSEL_RECORDING_FRAME		1	// record holding one frame
+#define SENSEL_RECORDING_INDEX		2	// record holding the frame index
+#define SENSEL_RECORDING_TRAILER	3	// last record, pointing at the index
+#define SENSEL_RECORDING_TRAILER_SIZE	(4 + 16)	// trailer size, including its length
+#define SENSEL_RECORDING_HEADER_SIZE	(8 + 4)		// magic and endianness marker
+#define SENSEL_RECORDING_BUFFER		(1 << 24)	// bytes buffered for the writer
+#define SENSEL_RECORDING_MAX_SIDE	1024		// rows or columns a replayed sensor may have
+#define SENSEL_RECORDING_MAX_MM		10000.0		// width or height a replayed sensor may have
+
+/*
+	One frame index entry, as stored in the index record
+*/
+typedef struct _sensel_index_entry
+{
+	unsigned long long i_time;		// recorded usec
+	unsigned long long i_offset;	// offset of the frame record
+} t_sensel_index_entry;
+
+/*
+	Upper bound for the size of one frame record, including
+	its length prefix
+*/
+static unsigned int sensel_recording_frame_size(const SenselSensorInfo *info)
+{
+	return(4 + 1 + 8 + 4 + 4 + 4
+		+ info->max_contacts * (4 + 18 * 4)
+		+ info->num_rows * info->num_cols * (sizeof(float) + 1)
+		+ 3 * 4);
+}
+
+static void sensel_put(unsigned char *buf, unsigned int *pos, const void *value, unsigned int size)
+{
+	memcpy(buf + *pos, value, size);
+	*pos += size;
+}
+
+static void sensel_get(const unsigned char *buf, unsigned int *pos, void *value, unsigned int size)
+{
+	memcpy(value, buf + *pos, size);
+	*pos += size;
+}
+
+/*
+	Serializes a frame record into buf, returning its size
+*/
+static unsigned int sensel_recording_write_frame(unsigned char *buf, const SenselSensorInfo *info,
+	const SenselFrameData *frame, unsigned long long time, unsigned int timestamp)
+{
+	unsigned int pos = 4, length;
+	unsigned char type = SENSEL_RECORDING_FRAME, pad[2] = { 0, 0 };
+	int cells = info->num_rows * info->num_cols;
+
+	sensel_put(buf, &pos, &type, 1);
+	sensel_put(buf, &pos, &time, 8);
+	sensel_put(buf, &pos, &timestamp, 4);
+	sensel_put(buf, &pos, &frame->lost_frame_count, 4);
+	sensel_put(buf, &pos, &frame->content_bit_mask, 1);
+	sensel_put(buf, &pos, &frame->n_contacts, 1);
+	sensel_put(buf, &pos, pad, 2);
+
+	for (int c = 0; c < frame->n_contacts; c++)
+	{
+		const SenselContact *contact = &frame->contacts[c];
+		unsigned char state = (unsigned char)contact->state;
+
+		sensel_put(buf, &pos, &contact->content_bit_mask, 1);
+		sensel_put(buf, &pos, &contact->id, 1);
+		sensel_put(buf, &pos, &state, 1);
+		sensel_put(buf, &pos, pad, 1);
+		sensel_put(buf, &pos, &contact->x_pos, 4 * 4);
+		if (contact->content_bit_mask & CONTACT_MASK_ELLIPSE)
+			sensel_put(buf, &pos, &contact->orientation, 3 * 4);
+		if (contact->content_bit_mask & CONTACT_MASK_DELTAS)
+			sensel_put(buf, &pos, &contact->delta_x, 4 * 4);
+		if (contact->content_bit_mask & CONTACT_MASK_BOUNDING_BOX)
+			sensel_put(buf, &pos, &contact->min_x, 4 * 4);
+		if (contact->content_bit_mask & CONTACT_MASK_PEAK)
+			sensel_put(buf, &pos, &contact->peak_x, 3 * 4);
+	}
+	if (frame->content_bit_mask & FRAME_CONTENT_PRESSURE_MASK)
+		sensel_put(buf, &pos, frame->force_array, cells * sizeof(float));
+	if (frame->content_bit_mask & FRAME_CONTENT_LABELS_MASK)
+		sensel_put(buf, &pos, frame->labels_array, cells);
+	if (frame->content_bit_mask & FRAME_CONTENT_ACCEL_MASK)
+		sensel_put(buf, &pos, &frame->accel_data->x, 3 * 4);
+
+	length = pos - 4;
+	memcpy(buf, &length, 4);
+	return(pos);
+}
+
+/*
+	Takes size bytes at *pos out of a record of length bytes into
+	value (or skips them if value is NULL), returning:
+		0 for success
+		-1 if the record is too short
+*/
+static int sensel_take(const unsigned char *buf, unsigned int length, unsigned int *pos,
+	void *value, unsigned int size)
+{
+	if (size > length - *pos)
+		return(-1);
+	if (value != NULL)
+		memcpy(value, buf + *pos, size);
+	*pos += size;
+	return(0);
+}
+
+/*
+	Parses a frame record's payload (after the type byte, length
+	bytes long) into frame, keeping only the content the reader
+	asked for. Nothing in the payload is trusted, returning:
+		0 for success
+		-1 if the record is too short for what it claims to hold
+*/
+static int sensel_recording_read_frame(const unsigned char *buf, unsigned int length,
+	const SenselSensorInfo *info, unsigned char content, SenselFrameData *frame,
+	unsigned long long *time, unsigned int *timestamp)
+{
+	unsigned int pos = 0;
+	unsigned char n_contacts, recorded, pad[2];
+	unsigned int cells = info->num_rows * info->num_cols;
+
+	if (sensel_take(buf, length, &pos, time, 8)
+		|| sensel_take(buf, length, &pos, timestamp, 4)
+		|| sensel_take(buf, length, &pos, &frame->lost_frame_count, 4)
+		|| sensel_take(buf, length, &pos, &recorded, 1)
+		|| sensel_take(buf, length, &pos, &n_contacts, 1)
+		|| sensel_take(buf, length, &pos, pad, 2))
+	{
+		return(-1);
+	}
+
+	// more contacts than the sensor has cannot be parsed past
+	if (n_contacts > info->max_contacts)
+		return(-1);
+	frame->n_contacts = 0;
+	frame->content_bit_mask = recorded & content;
+
+	for (int c = 0; c < n_contacts; c++)
+	{
+		SenselContact *contact = &frame->contacts[c];
+		unsigned char state;
+
+		memset(contact, 0, sizeof(SenselContact));
+		if (sensel_take(buf, length, &pos, &contact->content_bit_mask, 1)
+			|| sensel_take(buf, length, &pos, &contact->id, 1)
+			|| sensel_take(buf, length, &pos, &state, 1)
+			|| sensel_take(buf, length, &pos, pad, 1)
+			|| sensel_take(buf, length, &pos, &contact->x_pos, 4 * 4)
+			|| ((contact->content_bit_mask & CONTACT_MASK_ELLIPSE)
+				&& sensel_take(buf, length, &pos, &contact->orientation, 3 * 4))
+			|| ((contact->content_bit_mask & CONTACT_MASK_DELTAS)
+				&& sensel_take(buf, length, &pos, &contact->delta_x, 4 * 4))
+			|| ((contact->content_bit_mask & CONTACT_MASK_BOUNDING_BOX)
+				&& sensel_take(buf, length, &pos, &contact->min_x, 4 * 4))
+			|| ((contact->content_bit_mask & CONTACT_MASK_PEAK)
+				&& sensel_take(buf, length, &pos, &contact->peak_x, 3 * 4)))
+		{
+			return(-1);
+		}
+		contact->state = state;
+	}
+	if ((recorded & FRAME_CONTENT_PRESSURE_MASK)
+		&& sensel_take(buf, length, &pos,
+			(content & FRAME_CONTENT_PRESSURE_MASK) ? frame->force_array : NULL,
+			cells * sizeof(float)))
+	{
+		return(-1);
+	}
+	if ((recorded & FRAME_CONTENT_LABELS_MASK)
+		&& sensel_take(buf, length, &pos,
+			(content & FRAME_CONTENT_LABELS_MASK) ? frame->labels_array : NULL, cells))
+	{
+		return(-1);
+	}
+	if (((recorded & content) & FRAME_CONTENT_ACCEL_MASK)
+		&& sensel_take(buf, length, &pos, &frame->accel_data->x, 3 * 4))
+	{
+		return(-1);
+	}
+	frame->n_contacts = n_contacts;
+	return(0);
+}
+
+/*
+	A recording in progress. The Sensel thread serializes frames
+	into a byte ring that a dedicated writer thread drains to
+	disk, so a slow disk can only ever cost dropped frames,
+	never a stalled read. Once r_done is set the writer flushes
+	what is left, closes the file and frees the recorder.
+*/
+typedef struct _sensel_recorder
+{
+	FILE *r_file;
+	unsigned char *r_buffer;
+	unsigned int r_size;			// always a power of two
+	atomic_uint r_read;				// owned by the writer thread
+	atomic_uint r_write;			// owned by the Sensel thread
+	atomic_int r_done;
+	atomic_int r_failed;			// a write fell short, nothing more is written
+
+	// Sensel thread side, handed over to the writer thread
+	// together with r_done
+	unsigned char *r_scratch;		// one serialized frame
+	unsigned int r_scratch_size;
+	unsigned long long r_start;		// usec when recording started
+	unsigned long long r_offset;	// file offset of the next record
+	t_sensel_index_entry *r_index;
+	int r_index_size;
+	int r_frames;
+	int r_dropped;
+} t_sensel_recorder;
+
+/*
+	Writer thread: appends the frame index and the trailer
+	pointing at it, once all frames are on disk, returning:
+		0 for success
+		-1 if a write fell short
+*/
+static int sensel_recorder_write_index(t_sensel_recorder *r)
+{
+	unsigned int length = 1 + 3 + 4 + r->r_frames * sizeof(t_sensel_index_entry);
+	unsigned char head[4 + 1 + 3 + 4], trailer[SENSEL_RECORDING_TRAILER_SIZE];
+	unsigned int pos = 0, count = r->r_frames;
+	unsigned char type = SENSEL_RECORDING_INDEX, pad[7] = { 0 };
+
+	sensel_put(head, &pos, &length, 4);
+	sensel_put(head, &pos, &type, 1);
+	sensel_put(head, &pos, pad, 3);
+	sensel_put(head, &pos, &count, 4);
+	if (fwrite(head, 1, pos, r->r_file) != pos
+		|| fwrite(r->r_index, sizeof(t_sensel_index_entry), count, r->r_file) != count)
+	{
+		return(-1);
+	}
+
+	pos = 0;
+	length = SENSEL_RECORDING_TRAILER_SIZE - 4;
+	type = SENSEL_RECORDING_TRAILER;
+	sensel_put(trailer, &pos, &length, 4);
+	sensel_put(trailer, &pos, &type, 1);
+	sensel_put(trailer, &pos, pad, 7);
+	sensel_put(trailer, &pos, &r->r_offset, 8);
+	if (fwrite(trailer, 1, pos, r->r_file) != pos)
+		return(-1);
+	return(0);
+}
+
+/*
+	Writer thread: drains the byte ring to the file. Once a write
+	falls short (the disk is full, say) the rest is let go of,
+	for the Sensel thread to stop recording, and the recording
+	gets no index, which would point at frames never written.
+*/
+static void *sensel_recorder_thread(void *ptr)
+{
+	t_sensel_recorder *r = (t_sensel_recorder *)ptr;
+
+	for (;;)
+	{
+		// check for done first, so that nothing written
+		// before it was set can be missed below
+		int done = atomic_load_explicit(&r->r_done, memory_order_acquire);
+		unsigned int read = atomic_load_explicit(&r->r_read, memory_order_relaxed);
+		unsigned int write = atomic_load_explicit(&r->r_write, memory_order_acquire);
+
+		if (read != write)
+		{
+			unsigned int offset = read & (r->r_size - 1);
+			unsigned int n = write - read;
+			if (n > r->r_size - offset)
+				n = r->r_size - offset;
+			if (!atomic_load_explicit(&r->r_failed, memory_order_relaxed)
+				&& fwrite(r->r_buffer + offset, 1, n, r->r_file) != n)
+			{
+				atomic_store_explicit(&r->r_failed, 1, memory_order_relaxed);
+			}
+			atomic_store_explicit(&r->r_read, read + n, memory_order_release);
+		}
+		else if (done)
+			break;
+		else
+			usleep(5000);
+	}
+
+	if (r->r_index != NULL)
+	{
+		// anything still buffered has to make it to disk first
+		if (!atomic_load_explicit(&r->r_failed, memory_order_relaxed)
+			&& fflush(r->r_file) == 0)
+		{
+			sensel_recorder_write_index(r);
+		}
+		freebytes(r->r_index, r->r_index_size * sizeof(t_sensel_index_entry));
+	}
+	fclose(r->r_file);
+	freebytes(r->r_buffer, r->r_size);
+	freebytes(r, sizeof(t_sensel_recorder));
+	return(0);
+}
+
+/*
+	Pd thread side: starts the writer thread for an open file
+*/
+static t_sensel_recorder *sensel_recorder_new(FILE *file)
+{
+	t_sensel_recorder *r = (t_sensel_recorder *)getbytes(sizeof(t_sensel_recorder));
+	unsigned int endian = SENSEL_RECORDING_ENDIAN;
+	pthread_t thread;
+
+	atomic_init(&r->r_failed, (fwrite(SENSEL_RECORDING_MAGIC, 1, 8, file) != 8
+		|| fwrite(&endian, 4, 1, file) != 1));
+
+	r->r_file = file;
+	r->r_size = SENSEL_RECORDING_BUFFER;
+	r->r_buffer = (unsigned char *)getbytes(r->r_size);
+	atomic_init(&r->r_read, 0);
+	atomic_init(&r->r_write, 0);
+	atomic_init(&r->r_done, 0);
+	r->r_scratch = NULL;
+	r->r_index = NULL;
+	r->r_index_size = 0;
+	r->r_frames = 0;
+	r->r_offset = SENSEL_RECORDING_HEADER_SIZE;
+
+	pthread_create(&thread, NULL, sensel_recorder_thread, r);
+	pthread_detach(thread);
+	return(r);
+}
+
+/*
+	Sensel thread side: appends bytes to the ring, returning:
+		0 for success
+		-1 if the writer has fallen behind (nothing is written)
+*/
+static int sensel_recorder_push(t_sensel_recorder *r, const unsigned char *data, unsigned int n)
+{
+	unsigned int write = atomic_load_explicit(&r->r_write, memory_order_relaxed);
+	unsigned int read = atomic_load_explicit(&r->r_read, memory_order_acquire);
+	unsigned int offset = write & (r->r_size - 1);
+	unsigned int first = r->r_size - offset;
+
+	if (r->r_size - (write - read) < n)
+		return(-1);
+	if (first > n)
+		first = n;
+	memcpy(r->r_buffer + offset, data, first);
+	memcpy(r->r_buffer, data + first, n - first);
+	atomic_store_explicit(&r->r_write, write + n, memory_order_release);
+	return(0);
+}
+
+/*
+	Sensel thread side: starts recording frames of a sensor
+*/
+static void sensel_recorder_attach(t_sensel_recorder *r, const SenselSensorInfo *info)
+{
+	unsigned char header[32];
+	unsigned int pos = 4, length;
+	unsigned char type = SENSEL_RECORDING_SENSOR, pad[3] = { 0, 0, 0 };
+
+	sensel_put(header, &pos, &type, 1);
+	sensel_put(header, &pos, &info->num_rows, 2);
+	sensel_put(header, &pos, &info->num_cols, 2);
+	sensel_put(header, &pos, &info->max_contacts, 1);
+	sensel_put(header, &pos, pad, 3);
+	sensel_put(header, &pos, &info->width, 4);
+	sensel_put(header, &pos, &info->height, 4);
+	length = pos - 4;
+	memcpy(header, &length, 4);
+	sensel_recorder_push(r, header, pos);
+	r->r_offset += pos;
+
+	r->r_scratch_size = sensel_recording_frame_size(info);
+	r->r_scratch = (unsigned char *)getbytes(r->r_scratch_size);
+	r->r_start = sensel_monotonic_usec();
+	r->r_frames = 0;
+	r->r_dropped = 0;
+}
+
+/*
+	Sensel thread side: records one frame, dropping it if the
+	writer thread cannot keep up
+*/
+static void sensel_recorder_frame(t_sensel_recorder *r, const SenselSensorInfo *info,
+	const SenselFrameData *frame, unsigned long long now, unsigned int timestamp)
+{
+	unsigned long long time = now - r->r_start;
+	unsigned int n = sensel_recording_write_frame(r->r_scratch, info, frame, time, timestamp);
+
+	if (sensel_recorder_push(r, r->r_scratch, n) < 0)
+	{
+		r->r_dropped++;
+		return;
+	}
+
+	if (r->r_frames == r->r_index_size)
+	{
+		int size = (r->r_index_size ? 2 * r->r_index_size : 4096);
+		r->r_index = (t_sensel_index_entry *)resizebytes(r->r_index,
+			r->r_index_size * sizeof(t_sensel_index_entry), size * sizeof(t_sensel_index_entry));
+		r->r_index_size = size;
+	}
+	r->r_index[r->r_frames].i_time = time;
+	r->r_index[r->r_frames].i_offset = r->r_offset;
+	r->r_offset += n;
+	r->r_frames++;
+}
+
+/*
+	Sensel thread side: stops recording and hands the recorder
+	over to its writer thread, which frees it once done
+*/
+static void sensel_recorder_detach(t_sensel_recorder *r)
+{
+	if (r->r_scratch != NULL)
+		freebytes(r->r_scratch, r->r_scratch_size);
+	atomic_store_explicit(&r->r_done, 1, memory_order_release);
+}
+
+/*
+	Replay backend: plays a recording back through the regular
+	pipeline, with frames becoming available at their recorded
+	time scaled by the replay speed (0 replays as fast as the
+	Sensel thread can read). The file is mapped into memory and
+	frames are located through the frame index, so seeking to
+	any point of a long recording costs a binary search.
+*/
+#define SENSEL_REPLAY_PREFIX		"replay:"
+#define SENSEL_REPLAY_BUFFERED_FRAMES	64
+#define SENSEL_REPLAY_SEEK			0	// configure parameter: seek to msec
+
+typedef struct _sensel_replay
+{
+	const unsigned char *p_map;		// the whole recording
+	size_t p_map_size;
+#ifdef WIN32
+	HANDLE p_file;
+	HANDLE p_mapping;
+#endif
+	SenselSensorInfo p_info;
+	unsigned char p_content;
+	unsigned char p_contacts_mask;
+	float p_speed;
+	const unsigned char *p_index;	// p_frames t_sensel_index_entry
+	t_sensel_index_entry *p_built;	// the index, if the file had none
+	unsigned int p_frames;
+	int p_scanning;
+	unsigned long long p_start;		// usec when frame 0 would have been due
+	unsigned long long p_base;		// recorded time of frame 0
+	unsigned int p_next;			// next frame to deliver
+	unsigned int p_due;				// first frame that is not due yet
+} t_sensel_replay;
+
+static void sensel_replay_entry(const t_sensel_replay *p, unsigned int frame, t_sensel_index_entry *entry)
+{
+	// the index may sit unaligned in the mapping
+	memcpy(entry, p->p_index + frame * sizeof(t_sensel_index_entry), sizeof(t_sensel_index_entry));
+}
+
+static unsigned long long sensel_replay_time(const t_sensel_replay *p, unsigned int frame)
+{
+	t_sensel_index_entry entry;
+	sensel_replay_entry(p, frame, &entry);
+	return(entry.i_time - p->p_base);
+}
+
+/*
+	Maps a file read-only, returning:
+		0 for success
+		-1 if it cannot be mapped
+*/
+static int sensel_replay_map(t_sensel_replay *p, const char *path)
+{
+#ifdef WIN32
+	LARGE_INTEGER size;
+
+	p->p_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (p->p_file == INVALID_HANDLE_VALUE)
+		return(-1);
+	if (!GetFileSizeEx(p->p_file, &size) || size.QuadPart == 0
+		|| (p->p_mapping = CreateFileMappingA(p->p_file, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL)
+	{
+		CloseHandle(p->p_file);
+		return(-1);
+	}
+	p->p_map = (const unsigned char *)MapViewOfFile(p->p_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (p->p_map == NULL)
+	{
+		CloseHandle(p->p_mapping);
+		CloseHandle(p->p_file);
+		return(-1);
+	}
+	p->p_map_size = (size_t)size.QuadPart;
+#else
+	struct stat st;
+	void *map;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return(-1);
+	if (fstat(fd, &st) < 0 || st.st_size == 0
+		|| (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+	{
+		close(fd);
+		return(-1);
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+	p->p_map = (const unsigned char *)map;
+	p->p_map_size = st.st_size;
+#endif
+	return(0);
+}
+
+static void sensel_replay_unmap(t_sensel_replay *p)
+{
+#ifdef WIN32
+	UnmapViewOfFile(p->p_map);
+	CloseHandle(p->p_mapping);
+	CloseHandle(p->p_file);
+#else
+	munmap((void *)p->p_map, p->p_map_size);
+#endif
+}
+
+/*
+	Returns the length of the record at offset, or 0 if there
+	is no complete record there
+*/
+static unsigned int sensel_replay_record(const t_sensel_replay *p, unsigned long long offset)
+{
+	unsigned int length;
+
+	// offset comes from the file, so it must not wrap around
+	if (offset > p->p_map_size || p->p_map_size - offset < 5)
+		return(0);
+	memcpy(&length, p->p_map + offset, 4);
+	if (length < 1 || length > p->p_map_size - offset - 4)
+		return(0);
+	return(length);
+}
+
+/*
+	Finds the index written when the recording was stopped,
+	returning:
+		0 for success
+		-1 if the recording has no (valid) index
+*/
+static int sensel_replay_find_index(t_sensel_replay *p)
+{
+	unsigned long long offset, trailer = p->p_map_size - SENSEL_RECORDING_TRAILER_SIZE;
+	unsigned int length, count;
+
+	if (p->p_map_size < SENSEL_RECORDING_HEADER_SIZE + SENSEL_RECORDING_TRAILER_SIZE
+		|| sensel_replay_record(p, trailer) != SENSEL_RECORDING_TRAILER_SIZE - 4
+		|| p->p_map[trailer + 4] != SENSEL_RECORDING_TRAILER)
+	{
+		return(-1);
+	}
+	memcpy(&offset, p->p_map + trailer + 12, 8);
+	if ((length = sensel_replay_record(p, offset)) < 1 + 3 + 4
+		|| p->p_map[offset + 4] != SENSEL_RECORDING_INDEX)
+	{
+		return(-1);
+	}
+	memcpy(&count, p->p_map + offset + 8, 4);
+	if (count != (length - 1 - 3 - 4) / sizeof(t_sensel_index_entry))
+		return(-1);
+	p->p_index = p->p_map + offset + 12;
+	p->p_frames = count;
+
+	// an index pointing outside the file or back in time is
+	// not trusted, the records are walked instead
+	t_sensel_index_entry entry, previous = { 0, 0 };
+	for (unsigned int i = 0; i < count; i++)
+	{
+		sensel_replay_entry(p, i, &entry);
+		if (entry.i_offset < SENSEL_RECORDING_HEADER_SIZE
+			|| sensel_replay_record(p, entry.i_offset) == 0
+			|| entry.i_time < previous.i_time)
+		{
+			p->p_index = NULL;
+			p->p_frames = 0;
+			return(-1);
+		}
+		previous = entry;
+	}
+	return(0);
+}
+
+/*
+	Indexes a recording without an index by walking its records
+	(only their headers are touched)
+*/
+static void sensel_replay_build_index(t_sensel_replay *p, unsigned long long offset)
+{
+	unsigned int length, size = 0;
+
+	p->p_frames = 0;
+	while ((length = sensel_replay_record(p, offset)) > 0)
+	{
+		if (p->p_map[offset + 4] == SENSEL_RECORDING_FRAME && length >= 1 + 8)
+		{
+			if (p->p_frames == size)
+			{
+				unsigned int grown = (size ? 2 * size : 4096);
+				p->p_built = (t_sensel_index_entry *)resizebytes(p->p_built,
+					size * sizeof(t_sensel_index_entry), grown * sizeof(t_sensel_index_entry));
+				size = grown;
+			}
+			memcpy(&p->p_built[p->p_frames].i_time, p->p_map + offset + 5, 8);
+			p->p_built[p->p_frames].i_offset = offset;
+			p->p_frames++;
+		}
+		offset += 4 + length;
+	}
+	if (p->p_built != NULL && p->p_frames < size)
+	{
+		p->p_built = (t_sensel_index_entry *)resizebytes(p->p_built,
+			size * sizeof(t_sensel_index_entry), p->p_frames * sizeof(t_sensel_index_entry));
+	}
+	p->p_index = (const unsigned char *)p->p_built;
+}
+
+static SenselStatus sensel_replay_open(SENSEL_HANDLE *handle, const char *path, float speed)
+{
+	t_sensel_replay *p = (t_sensel_replay *)getbytes(sizeof(t_sensel_replay));
+	unsigned long long offset = SENSEL_RECORDING_HEADER_SIZE;
+	unsigned int endian, length, pos = offset + 5;
+
+	if (sensel_replay_map(p, path) < 0)
+	{
+		freebytes(p, sizeof(t_sensel_replay));
+		return(SENSEL_ERROR);
+	}
+	if (p->p_map_size >= SENSEL_RECORDING_HEADER_SIZE)
+		memcpy(&endian, p->p_map + 8, 4);
+	else
+		endian = 0;
+	if (endian != SENSEL_RECORDING_ENDIAN || memcmp(p->p_map, SENSEL_RECORDING_MAGIC, 8)
+		|| (length = sensel_replay_record(p, offset)) < 1 + 2 + 2 + 1 + 3 + 4 + 4
+		|| p->p_map[offset + 4] != SENSEL_RECORDING_SENSOR)
+	{
+		sensel_replay_unmap(p);
+		freebytes(p, sizeof(t_sensel_replay));
+		return(SENSEL_ERROR);
+	}
+
+	sensel_get(p->p_map, &pos, &p->p_info.num_rows, 2);
+	sensel_get(p->p_map, &pos, &p->p_info.num_cols, 2);
+	sensel_get(p->p_map, &pos, &p->p_info.max_contacts, 1);
+	pos += 3;
+	sensel_get(p->p_map, &pos, &p->p_info.width, 4);
+	sensel_get(p->p_map, &pos, &p->p_info.height, 4);
+	// the sensor info sizes every buffer, so it has to be sane
+	if (p->p_info.num_rows < 1 || p->p_info.num_rows > SENSEL_RECORDING_MAX_SIDE
+		|| p->p_info.num_cols < 1 || p->p_info.num_cols > SENSEL_RECORDING_MAX_SIDE
+		|| p->p_info.max_contacts < 1
+		|| !(p->p_info.width > 0 && p->p_info.width < SENSEL_RECORDING_MAX_MM)
+		|| !(p->p_info.height > 0 && p->p_info.height < SENSEL_RECORDING_MAX_MM))
+	{
+		sensel_replay_unmap(p);
+		freebytes(p, sizeof(t_sensel_replay));
+		return(SENSEL_ERROR);
+	}
+	if (sensel_replay_find_index(p) < 0)
+		sensel_replay_build_index(p, offset + 4 + length);
+	if (p->p_frames > 0)
+	{
+		t_sensel_index_entry first;
+		sensel_replay_entry(p, 0, &first);
+		p->p_base = first.i_time;
+	}
+
+	p->p_content = FRAME_CONTENT_CONTACTS_MASK;
+	p->p_contacts_mask = CONTACT_MASK_ELLIPSE | CONTACT_MASK_DELTAS |
+		CONTACT_MASK_BOUNDING_BOX | CONTACT_MASK_PEAK;
+	p->p_speed = (speed < 0 ? 0 : speed);
+	*handle = p;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_close(SENSEL_HANDLE handle)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	sensel_replay_unmap(p);
+	if (p->p_built != NULL)
+		freebytes(p->p_built, p->p_frames * sizeof(t_sensel_index_entry));
+	freebytes(p, sizeof(t_sensel_replay));
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_get_sensor_info(SENSEL_HANDLE handle, SenselSensorInfo *info)
+{
+	*info = ((t_sensel_replay *)handle)->p_info;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_set_frame_content(SENSEL_HANDLE handle, unsigned char content)
+{
+	((t_sensel_replay *)handle)->p_content = content;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_set_contacts_mask(SENSEL_HANDLE handle, unsigned char mask)
+{
+	((t_sensel_replay *)handle)->p_contacts_mask = mask;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_allocate_frame_data(SENSEL_HANDLE handle, SenselFrameData **data)
+{
+	*data = sensel_frame_data_new(&((t_sensel_replay *)handle)->p_info);
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_free_frame_data(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	sensel_frame_data_free(&((t_sensel_replay *)handle)->p_info, data);
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_set_scan_mode(SENSEL_HANDLE handle, SenselScanMode mode)
+{
+	(void)handle;
+	(void)mode;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_start_scanning(SENSEL_HANDLE handle)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	double offset = 0;
+
+	// carry on from where the replay was stopped or seeked to
+	if (p->p_speed > 0 && p->p_next < p->p_frames)
+		offset = (double)sensel_replay_time(p, p->p_next) / p->p_speed;
+	p->p_scanning = 1;
+	p->p_start = sensel_monotonic_usec() - (unsigned long long)offset;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_stop_scanning(SENSEL_HANDLE handle)
+{
+	((t_sensel_replay *)handle)->p_scanning = 0;
+	return(SENSEL_OK);
+}
+
+/*
+	Finds the frames that are due by now, without reading them
+*/
+static SenselStatus sensel_replay_read_sensor(SENSEL_HANDLE handle)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	double elapsed = (double)(sensel_monotonic_usec() - p->p_start) * p->p_speed;
+
+	while (p->p_scanning && p->p_due < p->p_frames
+		&& p->p_due - p->p_next < SENSEL_REPLAY_BUFFERED_FRAMES)
+	{
+		if (p->p_speed > 0 && (double)sensel_replay_time(p, p->p_due) > elapsed)
+			break;
+		p->p_due++;
+	}
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_get_num_available_frames(SENSEL_HANDLE handle, unsigned int *num_frames)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	*num_frames = p->p_due - p->p_next;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_get_frame(SENSEL_HANDLE handle, SenselFrameData *data)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	t_sensel_index_entry entry;
+	unsigned long long time;
+	unsigned int timestamp;
+
+	// a corrupt record is skipped, leaving an empty frame behind
+	// in case it was the last one due
+	data->n_contacts = 0;
+	data->content_bit_mask = 0;
+	while (p->p_next < p->p_due)
+	{
+		sensel_replay_entry(p, p->p_next++, &entry);
+		unsigned int length = sensel_replay_record(p, entry.i_offset);
+		if (length > sensel_recording_frame_size(&p->p_info)
+			|| length < 1 + 8
+			|| p->p_map[entry.i_offset + 4] != SENSEL_RECORDING_FRAME)
+		{
+			continue;
+		}
+		if (sensel_recording_read_frame(p->p_map + entry.i_offset + 5, length - 1, &p->p_info,
+			p->p_content, data, &time, &timestamp) < 0)
+		{
+			data->n_contacts = 0;
+			data->content_bit_mask = 0;
+			continue;
+		}
+		// like the device, only report the groups asked for
+		for (int c = 0; c < data->n_contacts; c++)
+			data->contacts[c].content_bit_mask &= p->p_contacts_mask;
+		return(SENSEL_OK);
+	}
+	return(SENSEL_ERROR);
+}
+
+static SenselStatus sensel_replay_set_leds(SENSEL_HANDLE handle, const unsigned short *brightness, int n)
+{
+	(void)handle;
+	(void)brightness;
+	(void)n;
+	return(SENSEL_OK);
+}
+
+static SenselStatus sensel_replay_get_max_led_brightness(SENSEL_HANDLE handle, unsigned short *max_brightness)
+{
+	(void)handle;
+	(void)max_brightness;
+	return(SENSEL_ERROR);
+}
+
+static int sensel_replay_get_fd(SENSEL_HANDLE handle)
+{
+	(void)handle;
+	return(-1);
+}
+
+static int sensel_replay_next_frame_usec(SENSEL_HANDLE handle)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	double usec;
+
+	if (p->p_speed <= 0)
+		return(0);
+	if (p->p_due >= p->p_frames)
+		return(-1);
+	usec = (double)sensel_replay_time(p, p->p_due) / p->p_speed
+		- (double)(sensel_monotonic_usec() - p->p_start);
+	return(usec > 0 ? (int)usec : 0);
+}
+
+/*
+	Moves the replay to the first frame recorded at or after
+	msec (relative to the first frame)
+*/
+static void sensel_replay_seek(t_sensel_replay *p, int msec)
+{
+	unsigned long long target = (msec > 0 ? (unsigned long long)msec * 1000 : 0);
+	unsigned int low = 0, high = p->p_frames;
+
+	while (low < high)
+	{
+		unsigned int mid = low + (high - low) / 2;
+		if (sensel_replay_time(p, mid) < target)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	p->p_next = p->p_due = low;
+	if (p->p_scanning)
+		sensel_replay_start_scanning(p);
+}
+
+static SenselStatus sensel_replay_configure(SENSEL_HANDLE handle, int param, int value)
+{
+	if (param != SENSEL_REPLAY_SEEK)
+		return(SENSEL_ERROR);
+	sensel_replay_seek((t_sensel_replay *)handle, value);
+	return(SENSEL_OK);
+}
+
+static int sensel_replay_finished(SENSEL_HANDLE handle)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+	return(p->p_next >= p->p_frames);
+}
+
+static SenselStatus sensel_replay_get_timestamp(SENSEL_HANDLE handle, unsigned int *timestamp)
+{
+	t_sensel_replay *p = (t_sensel_replay *)handle;
+
+	// frames are stamped with the time they were due at, which
+	// replays the recorded timing at any speed
+	if (p->p_due == 0 || p->p_speed <= 0)
+		return(SENSEL_ERROR);
+	*timestamp = (unsigned int)(p->p_start
+		+ (unsigned long long)((double)sensel_replay_time(p, p->p_due - 1) / p->p_speed));
+	return(SENSEL_OK);
+}
+
+static const t_sensel_backend sensel_replay_backend =
+{
+	"replay",
+	sensel_replay_close,
+	sensel_replay_get_sensor_info,
+	sensel_replay_set_frame_content,
+	sensel_replay_set_contacts_mask,
+	sensel_replay_allocate_frame_data,
+	sensel_replay_free_frame_data,
+	sensel_replay_set_scan_mode,
+	sensel_replay_start_scanning,
+	sensel_replay_stop_scanning,
+	sensel_replay_read_sensor,
+	sensel_replay_get_num_available_frames,
+	sensel_replay_get_frame,
+	sensel_replay_set_leds,
+	sensel_replay_get_max_led_brightness,
+	sensel_replay_get_fd,
+	sensel_replay_next_frame_usec,
+	sensel_replay_configure,
+	sensel_replay_finished,
+	sensel_replay_get_timestamp,
+};
+
+/*
+	An array keeping track of which devices are
+	already connected up to maximum allowed by
+	the sensel API. It is accessed from every
+	object's Sensel thread, hence the mutex, which
+	is never held across any device I/O.
+*/
+static char sensel_connected_devices[SENSEL_MAX_DEVICES][64];
+static pthread_mutex_t sensel_connected_devices_mutex = PTHREAD_MUTEX_INITIALIZER;
+static t_sensel_histogram sensel_connected_devices_hold;	// usec the mutex was held
+
+/*
+	Locks the list, returning when it got the lock
+*/
+static unsigned long long sensel_connected_devices_lock(void)
+{
+	pthread_mutex_lock(&sensel_connected_devices_mutex);
+	return(sensel_monotonic_usec());
+}
+
+/*
+	Unlocks the list, counting how long it was held (the
+	histogram is only written while holding the lock)
+*/
+static void sensel_connected_devices_unlock(unsigned long long locked)
+{
+	sensel_histogram_add(&sensel_connected_devices_hold, sensel_monotonic_usec() - locked);
+	pthread_mutex_unlock(&sensel_connected_devices_mutex);
+}
+
+/*
+	Adds a device to the list of connected devices,
+	returning:
+		0 for success
+		-1 if the device is already on the list (or the list is full)
+*/
+static int add_connected_to_sensel_device_list(const char *serial)
+{
+	int i, free_slot = -1;
+	unsigned long long locked = sensel_connected_devices_lock();
+	for (i = 0; i < SENSEL_MAX_DEVICES; i++)
+	{
+		if (sensel_connected_devices[i][0] == '\0')
+		{
+			if (free_slot < 0)
+				free_slot = i;
+		}
+		else if (!strcmp(sensel_connected_devices[i], serial))
+		{
+			free_slot = -1;
+			break;
+		}
+	}
+	if (free_slot >= 0)
+	{
+		strncpy(sensel_connected_devices[free_slot], serial, 63);
+		sensel_connected_devices[free_slot][63] = '\0';
+	}
+	sensel_connected_devices_unlock(locked);
+
+	return(free_slot >= 0 ? 0 : -1);
+}
+
+/*
+	Removes device from the list of connected devices,
+	returning:
+		0 for success
+		-1 for failure (shouldn't happen as API should throw error first)
+*/
+static int remove_connected_to_sensel_device_list(const char *serial)
+{
+	int i, result = -1;
+	unsigned long long locked = sensel_connected_devices_lock();
+	for (i = 0; i < SENSEL_MAX_DEVICES; i++)
+	{
+		if (!strcmp(sensel_connected_devices[i], serial))
+		{
+			sensel_connected_devices[i][0] = '\0';
+			result = 0;
+			break;
+		}
+	}
+	sensel_connected_devices_unlock(locked);
+
+	return(result);
+}
+
+/*
+	Maps the device's frame timestamps onto the host's monotonic
+	clock. The host only sees a frame some time after the device
+	stamped it, so the reads that come in earliest tell the
+	offset between the two clocks best: the offset follows an
+	early read at once and late ones only slowly, and the drift
+	term takes up the difference between the clock rates, which
+	would otherwise keep pulling the offset along. Frames read
+	together are spread back from the latest one at the frame
+	period.
+*/
+#define SENSEL_CLOCK_FAST			0.5		// share of an early read's error taken
+#define SENSEL_CLOCK_SLOW			0.005	// share of a late read's error taken
+#define SENSEL_CLOCK_DRIFT			0.05	// share of a correction put into the drift
+#define SENSEL_CLOCK_MAX_DRIFT		0.001	// 1000 ppm, more is a broken clock
+#define SENSEL_CLOCK_RESYNC			1000000	// usec of error that restarts the estimate
+
+typedef struct _sensel_clock
+{
+	int c_valid;
+	unsigned int c_raw;				// latest device timestamp
+	unsigned long long c_device;	// the same, unwrapped
+	double c_offset;				// host minus device usec at c_device
+	double c_drift;					// host usec gained per device usec
+	double c_period;				// device usec per frame
+} t_sensel_clock;
+
+static void sensel_clock_reset(t_sensel_clock *c)
+{
+	c->c_valid = 0;
+	c->c_device = 0;
+	c->c_drift = 0;
+	c->c_period = 0;
+}
+
+/*
+	Sensel thread side: feeds the device timestamp of the latest
+	of frames frames read at host time now
+*/
+static void sensel_clock_update(t_sensel_clock *c, unsigned int raw, unsigned int frames,
+	unsigned long long now)
+{
+	if (!c->c_valid)
+	{
+		c->c_valid = 1;
+		c->c_raw = raw;
+		c->c_device = raw;
+		c->c_offset = (double)now - (double)c->c_device;
+		return;
+	}
+
+	// the timestamp wraps every 71 minutes
+	unsigned int elapsed = raw - c->c_raw;
+	if (elapsed == 0)
+		return;
+	c->c_raw = raw;
+	c->c_device += elapsed;
+
+	double period = (double)elapsed / (frames ? frames : 1);
+	c->c_period = (c->c_period > 0 ? c->c_period + 0.1 * (period - c->c_period) : period);
+
+	double offset = c->c_offset + c->c_drift * elapsed;
+	double error = (double)now - (double)c->c_device - offset;
+	if (fabs(error) > SENSEL_CLOCK_RESYNC)
+	{
+		// the device restarted its clock, or we lost track
+		c->c_offset = (double)now - (double)c->c_device;
+		c->c_drift = 0;
+		c->c_period = 0;
+		return;
+	}
+
+	double correction = error * (error < 0 ? SENSEL_CLOCK_FAST : SENSEL_CLOCK_SLOW);
+	c->c_offset = offset + correction;
+	c->c_drift += SENSEL_CLOCK_DRIFT * correction / elapsed;
+	if (c->c_drift > SENSEL_CLOCK_MAX_DRIFT)
+		c->c_drift = SENSEL_CLOCK_MAX_DRIFT;
+	else if (c->c_drift < -SENSEL_CLOCK_MAX_DRIFT)
+		c->c_drift = -SENSEL_CLOCK_MAX_DRIFT;
+}
+
+/*
+	Host usec of the frame that came back frames before the
+	latest one
+*/
+static unsigned long long sensel_clock_map(const t_sensel_clock *c, unsigned int back)
+{
+	double device = (double)c->c_device - back * c->c_period;
+	return((unsigned long long)(device + c->c_offset));
+}
+
+/*
+	Latest contact state per voice (contact id), shared with the
+	[sensel~] objects following the device. The Sensel thread is
+	the only writer; readers retry a few times if they catch it
+	mid-write (s_seq is odd while it writes), so neither side
+	ever waits on the other.
+*/
+#define SENSEL_VOICES				16
+
+typedef struct _sensel_voice
+{
+	float v_x;
+	float v_y;
+	float v_force;
+	float v_gate;
+} t_sensel_voice;
+
+typedef struct _sensel_snapshot
+{
+	atomic_uint s_seq;
+	unsigned int s_frame;			// frames written so far
+	unsigned long long s_time;		// host usec the device took the frame at
+	t_sensel_voice s_voices[SENSEL_VOICES];
+} t_sensel_snapshot;
+
+static void sensel_snapshot_init(t_sensel_snapshot *s)
+{
+	atomic_init(&s->s_seq, 0);
+	s->s_frame = 0;
+	s->s_time = 0;
+	memset(s->s_voices, 0, sizeof(s->s_voices));
+}
+
+/*
+	Sensel thread side: publishes a frame's contacts
+*/
+static void sensel_snapshot_write(t_sensel_snapshot *s, const SenselFrameData *frame, unsigned long long time)
+{
+	unsigned int seq = atomic_load_explicit(&s->s_seq, memory_order_relaxed);
+
+	atomic_store_explicit(&s->s_seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	for (int c = 0; c < frame->n_contacts; c++)
+	{
+		const SenselContact *contact = &frame->contacts[c];
+		t_sensel_voice *voice;
+
+		if (contact->id >= SENSEL_VOICES)
+			continue;
+		voice = &s->s_voices[contact->id];
+		voice->v_x = contact->x_pos;
+		voice->v_y = contact->y_pos;
+		if (contact->state == CONTACT_END)
+		{
+			voice->v_force = 0;
+			voice->v_gate = 0;
+		}
+		else
+		{
+			voice->v_force = contact->total_force;
+			voice->v_gate = 1;
+		}
+	}
+	s->s_frame++;
+	s->s_time = time;
+
+	atomic_store_explicit(&s->s_seq, seq + 2, memory_order_release);
+}
+
+/*
+	Reader side: copies the snapshot, returning:
+		0 for success
+		-1 if the writer kept getting in the way (copy is undefined)
+*/
+static int sensel_snapshot_read(t_sensel_snapshot *s, t_sensel_snapshot *copy)
+{
+	for (int tries = 0; tries < 4; tries++)
+	{
+		unsigned int seq = atomic_load_explicit(&s->s_seq, memory_order_acquire);
+
+		if (seq & 1)
+			continue;
+		copy->s_frame = s->s_frame;
+		copy->s_time = s->s_time;
+		memcpy(copy->s_voices, s->s_voices, sizeof(copy->s_voices));
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&s->s_seq, memory_order_relaxed) == seq)
+			return(0);
+	}
+	return(-1);
+}
+
+/*
+	Zone table: rectangles and polygons (in mm, like the contact
+	positions) with ids, kept sorted by id. The Sensel thread
+	finds a contact's zone through a grid over the sensor whose
+	cells hold the zones overlapping them, so each contact is
+	only tested against the few zones near it. The Pd thread
+	edits its own table and hands the Sensel thread a copy.
+*/
+#define SENSEL_ZONES				64		// one bit each in a grid cell
+#define SENSEL_ZONE_VERTICES		16
+#define SENSEL_ZONE_GRID			16		// cells along each side
+#define SENSEL_ZONE_UNKNOWN			0xff	// contact yet to be classified
+
+typedef struct _sensel_zone
+{
+	int z_id;
+	int z_vertices;				// 0 for a rectangle
+	float z_left, z_top, z_right, z_bottom;	// bounds
+	float z_x[SENSEL_ZONE_VERTICES];
+	float z_y[SENSEL_ZONE_VERTICES];
+} t_sensel_zone;
+
+typedef struct _sensel_zones
+{
+	int z_count;
+	t_sensel_zone z_zones[SENSEL_ZONES];
+	float z_cell_width;			// 0 until indexed for a sensor
+	float z_cell_height;
+	unsigned long long z_grid[SENSEL_ZONE_GRID * SENSEL_ZONE_GRID];
+} t_sensel_zones;
+
+/*
+	Pd thread side: adds a zone, or replaces the one with its
+	id, returning:
+		0 for success
+		-1 if the table is full
+*/
+static int sensel_zones_set(t_sensel_zones *z, const t_sensel_zone *zone)
+{
+	int i;
+
+	for (i = 0; i < z->z_count && z->z_zones[i].z_id < zone->z_id; i++)
+		;
+	if (i == z->z_count || z->z_zones[i].z_id != zone->z_id)
+	{
+		if (z->z_count == SENSEL_ZONES)
+			return(-1);
+		memmove(&z->z_zones[i + 1], &z->z_zones[i], (z->z_count - i) * sizeof(t_sensel_zone));
+		z->z_count++;
+	}
+	z->z_zones[i] = *zone;
+	return(0);
+}
+
+/*
+	Pd thread side: removes the zone with an id, if any
+*/
+static void sensel_zones_remove(t_sensel_zones *z, int id)
+{
+	for (int i = 0; i < z->z_count; i++)
+	{
+		if (z->z_zones[i].z_id == id)
+		{
+			memmove(&z->z_zones[i], &z->z_zones[i + 1], (z->z_count - i - 1) * sizeof(t_sensel_zone));
+			z->z_count--;
+			return;
+		}
+	}
+}
+
+/*
+	Grid cell of a coordinate, clamped to the grid
+*/
+static int sensel_zones_cell(float pos, float size)
+{
+	int cell = (int)(pos / size);
+
+	return(cell < 0 ? 0 : (cell >= SENSEL_ZONE_GRID ? SENSEL_ZONE_GRID - 1 : cell));
+}
+
+/*
+	Sensel thread side: indexes the zones for a sensor. Without
+	its size every zone goes into the one cell that is used.
+*/
+static void sensel_zones_index(t_sensel_zones *z, const SenselSensorInfo *info)
+{
+	memset(z->z_grid, 0, sizeof(z->z_grid));
+	if (info->width > 0 && info->height > 0)
+	{
+		z->z_cell_width = info->width / SENSEL_ZONE_GRID;
+		z->z_cell_height = info->height / SENSEL_ZONE_GRID;
+	}
+	else
+	{
+		z->z_cell_width = 0;
+		z->z_cell_height = 0;
+	}
+	for (int i = 0; i < z->z_count; i++)
+	{
+		const t_sensel_zone *zone = &z->z_zones[i];
+
+		if (z->z_cell_width == 0)
+		{
+			z->z_grid[0] |= 1ULL << i;
+			continue;
+		}
+		int left = sensel_zones_cell(zone->z_left, z->z_cell_width);
+		int right = sensel_zones_cell(zone->z_right, z->z_cell_width);
+		int top = sensel_zones_cell(zone->z_top, z->z_cell_height);
+		int bottom = sensel_zones_cell(zone->z_bottom, z->z_cell_height);
+
+		for (int row = top; row <= bottom; row++)
+			for (int col = left; col <= right; col++)
+				z->z_grid[row * SENSEL_ZONE_GRID + col] |= 1ULL << i;
+	}
+}
+
+/*
+	Whether a point lies inside a zone (even-odd rule for polygons)
+*/
+static int sensel_zone_contains(const t_sensel_zone *zone, float x, float y)
+{
+	int inside = 0;
+
+	if (x < zone->z_left || x > zone->z_right || y < zone->z_top || y > zone->z_bottom)
+		return(0);
+	if (zone->z_vertices == 0)
+		return(1);
+	for (int i = 0, j = zone->z_vertices - 1; i < zone->z_vertices; j = i++)
+	{
+		if ((zone->z_y[i] > y) != (zone->z_y[j] > y)
+			&& x < zone->z_x[j] + (zone->z_x[i] - zone->z_x[j])
+				* (y - zone->z_y[j]) / (zone->z_y[i] - zone->z_y[j]))
+		{
+			inside = !inside;
+		}
+	}
+	return(inside);
+}
+
+/*
+	Sensel thread side: the zone a point lies in, the one with
+	the lowest id where zones overlap, returning:
+		its index + 1
+		0 if it lies in none
+*/
+static int sensel_zones_find(const t_sensel_zones *z, float x, float y)
+{
+	unsigned long long candidates = z->z_grid[(z->z_cell_width == 0 ? 0
+		: sensel_zones_cell(y, z->z_cell_height) * SENSEL_ZONE_GRID
+			+ sensel_zones_cell(x, z->z_cell_width))];
+
+	for (int i = 0; candidates != 0; i++, candidates >>= 1)
+		if ((candidates & 1) && sensel_zone_contains(&z->z_zones[i], x, y))
+			return(i + 1);
+	return(0);
+}
+
+/*
+	Deadbands: a moving contact is only output once its position
+	(mm), force (grams) or area has changed by at least the band
+	since it was last output. A band of 0 leaves its quantity out.
+*/
+#define SENSEL_DEADBAND_POSITION	0
+#define SENSEL_DEADBAND_FORCE		1
+#define SENSEL_DEADBAND_AREA		2
+#define SENSEL_DEADBANDS			3
+
+typedef struct _sensel_deadband
+{
+	float d_x;					// as last output
+	float d_y;
+	float d_force;
+	float d_area;
+	int d_valid;
+} t_sensel_deadband;
+
+/*
+	Contact filters, run on every contact's x, y and force by
+	contact id: exponential smoothing or the One-Euro filter
+	(a low-pass whose cutoff rises with speed, so it smooths
+	resting contacts hard and lags little behind fast ones),
+	then optionally a constant-velocity Kalman filter on x and
+	y whose estimate is extrapolated by a look-ahead, to make
+	up for the time it took the frame to reach the patch
+*/
+#define SENSEL_FILTER_TYPE			0	// SENSEL_FILTER_OFF, _EXP or _EURO
+#define SENSEL_FILTER_SMOOTH		1	// exponential smoothing amount (0-1)
+#define SENSEL_FILTER_MINCUTOFF		2	// One-Euro cutoff at rest in Hz
+#define SENSEL_FILTER_BETA			3	// One-Euro cutoff increase with speed
+#define SENSEL_FILTER_DCUTOFF		4	// One-Euro cutoff of the speed in Hz
+#define SENSEL_FILTER_PREDICT		5	// look-ahead in msec, 0 = off
+
+#define SENSEL_FILTER_OFF			0
+#define SENSEL_FILTER_EXP			1
+#define SENSEL_FILTER_EURO			2
+
+#define SENSEL_PREDICT_MAX			50		// msec
+#define SENSEL_PREDICT_ACCEL		10000.0f	// mm/s^2, typical finger acceleration
+#define SENSEL_PREDICT_JITTER		0.1f	// mm, position noise
+
+typedef struct _sensel_filter
+{
+	int f_type;
+	float f_smooth;				// weight of the newest value
+	float f_mincutoff;
+	float f_beta;
+	float f_dcutoff;
+	float f_predict;			// sec
+} t_sensel_filter;
+
+typedef struct _sensel_track
+{
+	int t_valid;
+	unsigned long long t_time;	// usec of the last frame
+	float t_value[3];			// smoothed x, y and force
+	float t_speed[3];			// their filtered rate of change
+	float t_pos[2];				// Kalman estimate of x and y
+	float t_vel[2];
+	float t_p00[2], t_p01[2], t_p11[2];	// its covariance
+	float t_out[3];				// x, y and force to output
+} t_sensel_track;
+
+static void sensel_filter_set(t_sensel_filter *f, int param, float value)
+{
+	switch (param)
+	{
+		case SENSEL_FILTER_TYPE:
+			f->f_type = (int)value;
+			break;
+		case SENSEL_FILTER_SMOOTH:
+			f->f_smooth = 1 - value;
+			break;
+		case SENSEL_FILTER_MINCUTOFF:
+			f->f_mincutoff = value;
+			break;
+		case SENSEL_FILTER_BETA:
+			f->f_beta = value;
+			break;
+		case SENSEL_FILTER_DCUTOFF:
+			f->f_dcutoff = value;
+			break;
+		case SENSEL_FILTER_PREDICT:
+			f->f_predict = value / 1000.0f;
+			break;
+	}
+}
+
+/*
+	Weight of the newest value for a first order low-pass
+*/
+static float sensel_filter_alpha(float cutoff, float dt)
+{
+	float tau = 1.0f / (2.0f * (float)M_PI * cutoff);
+
+	return(1.0f / (1.0f + tau / dt));
+}
+
+/*
+	Sensel thread side: filters a contact's x, y and force (in)
+	taken at time (usec) into t_out
+*/
+static void sensel_track_update(const t_sensel_filter *f, t_sensel_track *t,
+	const float *in, unsigned long long time)
+{
+	float q = SENSEL_PREDICT_ACCEL * SENSEL_PREDICT_ACCEL;
+	float r = SENSEL_PREDICT_JITTER * SENSEL_PREDICT_JITTER;
+	int i;
+
+	if (!t->t_valid)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			t->t_value[i] = t->t_out[i] = in[i];
+			t->t_speed[i] = 0;
+		}
+		for (i = 0; i < 2; i++)
+		{
+			t->t_pos[i] = in[i];
+			t->t_vel[i] = 0;
+			t->t_p00[i] = r;
+			t->t_p01[i] = 0;
+			t->t_p11[i] = q;
+		}
+		t->t_time = time;
+		t->t_valid = 1;
+		return;
+	}
+
+	// frames read together without device timestamps share a time
+	float dt = (time > t->t_time ? (time - t->t_time) / 1000000.0f : 0.001f);
+	t->t_time = time;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (f->f_type == SENSEL_FILTER_EXP)
+			t->t_value[i] += f->f_smooth * (in[i] - t->t_value[i]);
+		else if (f->f_type == SENSEL_FILTER_EURO)
+		{
+			float speed = (in[i] - t->t_value[i]) / dt;
+
+			t->t_speed[i] += sensel_filter_alpha(f->f_dcutoff, dt) * (speed - t->t_speed[i]);
+			t->t_value[i] += sensel_filter_alpha(f->f_mincutoff + f->f_beta * fabsf(t->t_speed[i]), dt)
+				* (in[i] - t->t_value[i]);
+		}
+		else
+			t->t_value[i] = in[i];
+		t->t_out[i] = t->t_value[i];
+	}
+
+	if (f->f_predict <= 0)
+		return;
+	for (i = 0; i < 2; i++)
+	{
+		// predict, with the acceleration as white noise
+		t->t_pos[i] += t->t_vel[i] * dt;
+		t->t_p00[i] += dt * (2 * t->t_p01[i] + dt * t->t_p11[i]) + q * dt * dt * dt * dt / 4;
+		t->t_p01[i] += dt * t->t_p11[i] + q * dt * dt * dt / 2;
+		t->t_p11[i] += q * dt * dt;
+
+		// correct with the (smoothed) position
+		float gain_pos = t->t_p00[i] / (t->t_p00[i] + r);
+		float gain_vel = t->t_p01[i] / (t->t_p00[i] + r);
+		float error = t->t_value[i] - t->t_pos[i];
+
+		t->t_pos[i] += gain_pos * error;
+		t->t_vel[i] += gain_vel * error;
+		t->t_p11[i] -= gain_vel * t->t_p01[i];
+		t->t_p01[i] -= gain_pos * t->t_p01[i];
+		t->t_p00[i] -= gain_pos * t->t_p00[i];
+
+		t->t_out[i] = t->t_pos[i] + t->t_vel[i] * f->f_predict;
+	}
+}
+
+/*
+	Gestures, recognized on the device thread as frames come in
+	from the contacts' states kept by contact id. Tap, double
+	tap, hold and swipe are single-finger gestures: a contact that
+	was ever down together with another one makes none of them.
+	Pinch and rotate follow two contacts for as long as they are
+	the only ones down, relative to where they were when the
+	second one came down.
+*/
+#define SENSEL_GESTURE_TAP			0	// x, y
+#define SENSEL_GESTURE_DOUBLETAP	1	// x, y
+#define SENSEL_GESTURE_HOLD			2	// x, y
+#define SENSEL_GESTURE_SWIPE		3	// SENSEL_SWIPE_*, speed in m/s
+#define SENSEL_GESTURE_PINCH		4	// distance over the starting one
+#define SENSEL_GESTURE_ROTATE		5	// degrees clockwise
+#define SENSEL_GESTURES				6
+
+#define SENSEL_SWIPE_LEFT			0
+#define SENSEL_SWIPE_RIGHT			1
+#define SENSEL_SWIPE_UP				2
+#define SENSEL_SWIPE_DOWN			3
+
+#define SENSEL_GESTURE_SLOP			3.0f	// mm a tap or hold may wander
+#define SENSEL_GESTURE_TAP_TIME		200000	// usec a tap may last
+#define SENSEL_GESTURE_DOUBLE_TIME	300000	// usec from one tap to the next
+#define SENSEL_GESTURE_DOUBLE_DIST	10.0f	// mm from one tap to the next
+#define SENSEL_GESTURE_HOLD_TIME	500000	// usec until a still contact holds
+#define SENSEL_GESTURE_SWIPE_DIST	20.0f	// mm a swipe travels at least
+#define SENSEL_GESTURE_SWIPE_SPEED	0.1f	// m/s a swipe averages at least
+#define SENSEL_GESTURE_PINCH_START	0.05f	// scale change that starts a pinch
+#define SENSEL_GESTURE_PINCH_STEP	0.005f	// scale change output after that
+#define SENSEL_GESTURE_ROTATE_START	5.0f	// degrees that start a rotation
+#define SENSEL_GESTURE_ROTATE_STEP	0.5f	// degrees output after that
+
+// slots one contact's gestures take in a frame at most (a tap
+// and a double tap), and then a pinch and a rotation
+#define SENSEL_GESTURE_SLOTS		8
+
+static const char *sensel_gesture_names[SENSEL_GESTURES] =
+{
+	"tap", "doubletap", "hold", "swipe", "pinch", "rotate"
+};
+
+static const char *sensel_swipe_names[] =
+{
+	"left", "right", "up", "down"
+};
+
+typedef struct _sensel_gesture_contact
+{
+	int g_down;
+	unsigned long long g_start;	// usec it came down
+	float g_x0, g_y0;			// where
+	float g_travel;				// furthest it got from there in mm
+	int g_shared;				// down together with another contact
+	int g_held;					// hold has been output
+} t_sensel_gesture_contact;
+
+typedef struct _sensel_gestures
+{
+	int g_on;
+	t_sensel_gesture_contact g_contacts[256];	// per contact id
+	int g_tapped;				// a tap may still be doubled
+	unsigned long long g_tap_time;
+	float g_tap_x, g_tap_y;
+	int g_pair[2];				// ids of the two contacts, -1 for none
+	float g_distance0;			// their distance to begin with
+	float g_angle0;				// their angle in the last frame
+	float g_turn;				// degrees turned since the start
+	float g_scale;				// as last output
+	float g_angle;
+	int g_pinching;
+	int g_rotating;
+} t_sensel_gestures;
+
+static void sensel_gestures_reset(t_sensel_gestures *g)
+{
+	for (int i = 0; i < 256; i++)
+		g->g_contacts[i].g_down = 0;
+	g->g_tapped = 0;
+	g->g_pair[0] = g->g_pair[1] = -1;
+}
+
+/*
+	Sensel thread side: queues a gesture record with its values
+*/
+static void sensel_gesture_push(t_sensel_ring *r, int gesture, int argc, float a, float b)
+{
+	t_sensel_slot *args = sensel_ring_push(r, SENSEL_RECORD_GESTURE, 1 + argc);
+
+	if (args == NULL)
+		return;
+	args[0].s_float = gesture;
+	if (argc > 0)
+		args[1].s_float = a;
+	if (argc > 1)
+		args[2].s_float = b;
+}
+
+/*
+	Sensel thread side: follows two contacts (x and y of each in
+	pos) for pinch and rotate
+*/
+static void sensel_gestures_pair(t_sensel_gestures *g, t_sensel_ring *r, const int *ids, const float *pos)
+{
+	float dx = pos[2] - pos[0], dy = pos[3] - pos[1];
+	float distance = sqrtf(dx * dx + dy * dy);
+	float angle = atan2f(dy, dx) * (180.0f / (float)M_PI);
+
+	if (ids[0] != g->g_pair[0] || ids[1] != g->g_pair[1])
+	{
+		g->g_pair[0] = ids[0];
+		g->g_pair[1] = ids[1];
+		g->g_distance0 = distance;
+		g->g_angle0 = angle;
+		g->g_turn = 0;
+		g->g_scale = 1;
+		g->g_angle = 0;
+		g->g_pinching = g->g_rotating = 0;
+		return;
+	}
+
+	if (g->g_distance0 > 0)
+	{
+		float scale = distance / g->g_distance0;
+
+		if (!g->g_pinching && fabsf(scale - 1) >= SENSEL_GESTURE_PINCH_START)
+			g->g_pinching = 1;
+		if (g->g_pinching && fabsf(scale - g->g_scale) >= SENSEL_GESTURE_PINCH_STEP)
+		{
+			g->g_scale = scale;
+			sensel_gesture_push(r, SENSEL_GESTURE_PINCH, 1, scale, 0);
+		}
+	}
+
+	// y grows downwards, so a growing angle turns clockwise,
+	// summed up frame by frame to count whole turns
+	float delta = angle - g->g_angle0;
+	if (delta > 180)
+		delta -= 360;
+	else if (delta < -180)
+		delta += 360;
+	g->g_angle0 = angle;
+	g->g_turn += delta;
+	if (!g->g_rotating && fabsf(g->g_turn) >= SENSEL_GESTURE_ROTATE_START)
+		g->g_rotating = 1;
+	if (g->g_rotating && fabsf(g->g_turn - g->g_angle) >= SENSEL_GESTURE_ROTATE_STEP)
+	{
+		g->g_angle = g->g_turn;
+		sensel_gesture_push(r, SENSEL_GESTURE_ROTATE, 1, g->g_turn, 0);
+	}
+}
+
+/*
+	Sensel thread side: runs the gestures over the contacts of a
+	frame taken at time (usec) that are in a zone (all without
+	zones), at the positions in pos (x and y by contact index),
+	queuing a record for every gesture made
+*/
+static void sensel_gestures_frame(t_sensel_gestures *g, t_sensel_ring *r, const SenselFrameData *frame,
+	const unsigned char *zones, const float *pos, unsigned long long time)
+{
+	int down = 0;
+
+	for (int c = 0; c < frame->n_contacts; c++)
+		if (zones[c] && frame->contacts[c].state != CONTACT_END)
+			down++;
+
+	for (int c = 0; c < frame->n_contacts; c++)
+	{
+		const SenselContact *contact = &frame->contacts[c];
+		t_sensel_gesture_contact *gc = &g->g_contacts[contact->id];
+		float px = pos[2 * c], py = pos[2 * c + 1];
+
+		if (!zones[c])
+			continue;
+		if (contact->state == CONTACT_START || !gc->g_down)
+		{
+			gc->g_down = 1;
+			gc->g_start = time;
+			gc->g_x0 = px;
+			gc->g_y0 = py;
+			gc->g_travel = 0;
+			gc->g_shared = 0;
+			gc->g_held = 0;
+		}
+
+		float dx = px - gc->g_x0, dy = py - gc->g_y0;
+		float distance = sqrtf(dx * dx + dy * dy);
+		unsigned long long duration = time - gc->g_start;
+
+		if (distance > gc->g_travel)
+			gc->g_travel = distance;
+		if (down > 1)
+			gc->g_shared = 1;
+
+		if (gc->g_shared || gc->g_held)
+		{
+			if (contact->state == CONTACT_END)
+				gc->g_down = 0;
+			continue;
+		}
+		if (contact->state != CONTACT_END)
+		{
+			if (gc->g_travel < SENSEL_GESTURE_SLOP && duration >= SENSEL_GESTURE_HOLD_TIME)
+			{
+				gc->g_held = 1;
+				sensel_gesture_push(r, SENSEL_GESTURE_HOLD, 2, px, py);
+			}
+			continue;
+		}
+		gc->g_down = 0;
+
+		if (gc->g_travel < SENSEL_GESTURE_SLOP && duration < SENSEL_GESTURE_TAP_TIME)
+		{
+			float tx = px - g->g_tap_x, ty = py - g->g_tap_y;
+
+			sensel_gesture_push(r, SENSEL_GESTURE_TAP, 2, px, py);
+			if (g->g_tapped && time - g->g_tap_time < SENSEL_GESTURE_DOUBLE_TIME
+				&& tx * tx + ty * ty < SENSEL_GESTURE_DOUBLE_DIST * SENSEL_GESTURE_DOUBLE_DIST)
+			{
+				// a third tap starts over
+				g->g_tapped = 0;
+				sensel_gesture_push(r, SENSEL_GESTURE_DOUBLETAP, 2, px, py);
+			}
+			else
+			{
+				g->g_tapped = 1;
+				g->g_tap_time = time;
+				g->g_tap_x = px;
+				g->g_tap_y = py;
+			}
+		}
+		else if (distance >= SENSEL_GESTURE_SWIPE_DIST && duration > 0)
+		{
+			// mm per msec is m/s
+			float speed = distance / (duration / 1000.0f);
+
+			if (speed >= SENSEL_GESTURE_SWIPE_SPEED)
+			{
+				int direction = (fabsf(dx) >= fabsf(dy)
+					? (dx < 0 ? SENSEL_SWIPE_LEFT : SENSEL_SWIPE_RIGHT)
+					: (dy < 0 ? SENSEL_SWIPE_UP : SENSEL_SWIPE_DOWN));
+
+				sensel_gesture_push(r, SENSEL_GESTURE_SWIPE, 2, direction, speed);
+			}
+		}
+	}
+
+	if (down == 2)
+	{
+		int ids[2], n = 0;
+		float pair[4];
+
+		for (int c = 0; c < frame->n_contacts && n < 2; c++)
+		{
+			if (!zones[c] || frame->contacts[c].state == CONTACT_END)
+				continue;
+			ids[n] = frame->contacts[c].id;
+			pair[2 * n] = pos[2 * c];
+			pair[2 * n + 1] = pos[2 * c + 1];
+			n++;
+		}
+		sensel_gestures_pair(g, r, ids, pair);
+	}
+	else
+		g->g_pair[0] = g->g_pair[1] = -1;
+}
+
+/*
+	LED envelopes, run on the device thread: each LED ramps from
+	its brightness to that of its first segment in the segment's
+	time, then on through the following segments
+*/
+#define SENSEL_LED_SEGMENTS			8
+#define SENSEL_LED_RATE				100		// default LED writes per second at most
+#define SENSEL_LED_RATE_MAX			1000
+#define SENSEL_LED_PERCENT			100		// brightness of "led" messages at full
+#define SENSEL_LED_TABLE_FULL		65535	// brightness of an LED table at full
+
+typedef struct _sensel_led_ramp
+{
+	int r_n;					// segments, 0 while the LED stays put
+	int r_segment;				// the current one
+	unsigned long long r_start;	// usec it started
+	float r_from;				// brightness it started from
+	unsigned short r_target[SENSEL_LED_SEGMENTS];
+	unsigned int r_time[SENSEL_LED_SEGMENTS];	// usec
+} t_sensel_led_ramp;
+
+/*
+	Sensel thread side: starts a new envelope on an LED at
+	brightness from, or adds a segment to the one running
+*/
+static void sensel_led_ramp_add(t_sensel_led_ramp *r, int start, unsigned short from,
+	unsigned short target, unsigned int usec, unsigned long long now)
+{
+	if (start || r->r_n == 0)
+	{
+		r->r_n = 0;
+		r->r_segment = 0;
+		r->r_start = now;
+		r->r_from = from;
+	}
+	if (r->r_n < SENSEL_LED_SEGMENTS)
+	{
+		r->r_target[r->r_n] = target;
+		r->r_time[r->r_n] = usec;
+		r->r_n++;
+	}
+}
+
+/*
+	Sensel thread side: moves an LED's envelope on to now,
+	setting its brightness, and returning:
+		1 if the envelope is still running
+		0 if it is over (or there is none)
+*/
+static int sensel_led_ramp_run(t_sensel_led_ramp *r, unsigned short *brightness, unsigned long long now)
+{
+	while (r->r_segment < r->r_n)
+	{
+		unsigned long long elapsed = (now > r->r_start ? now - r->r_start : 0);
+		float target = r->r_target[r->r_segment];
+
+		if (elapsed < r->r_time[r->r_segment])
+		{
+			*brightness = (unsigned short)(r->r_from
+				+ (target - r->r_from) * elapsed / r->r_time[r->r_segment] + 0.5f);
+			return(1);
+		}
+		r->r_start += r->r_time[r->r_segment];
+		r->r_from = target;
+		*brightness = r->r_target[r->r_segment];
+		r->r_segment++;
+	}
+	r->r_n = 0;
+	return(0);
+}
+
+/*
+	Statistics of the blob of cells the device labelled with a
+	contact's id, gathered in one row-major pass over the labels
+	and force images: cell count, force-weighted centroid and
+	second moments, and the length of the blob's outline. Sums
+	are taken relative to the first cell of the blob found, to
+	keep them small enough for floats.
+*/
+#define SENSEL_BLOB_FIELDS			7	// cells, x, y, xx, yy, xy, perimeter
+
+typedef struct _sensel_blob
+{
+	unsigned int b_cells;		// 0 while the label is not in the frame
+	int b_row, b_col;			// first cell found
+	float b_force;
+	float b_x, b_y;				// force-weighted sums of the offsets
+	float b_xx, b_yy, b_xy;
+	unsigned int b_edges_x;		// outline edges along a row and a column
+	unsigned int b_edges_y;
+} t_sensel_blob;
+
+/*
+	An open device, shared by every [sensel] object connected to
+	it (its subscribers). The Sensel thread reads and decodes each
+	frame once and hands it, read-only, to every subscriber in
+	turn, each of which outputs it with its own fields, format and
+	force image. Settings of the device itself are merged over the
+	subscribers: the frame content and contact fields any of them
+	needs, event mode if any of them asked for it and the shortest
+	poll time and LED rate. The device is closed when its last
+	subscriber lets go of it. Hubs only ever live on the Sensel thread.
+*/
+typedef struct _sensel_hub
+{
+	const t_sensel_backend *h_backend;
+	SENSEL_HANDLE h_handle;
+	SenselFrameData *h_frame;
+	char h_serial[64];
+	SenselSensorInfo h_info;
+	int h_scanning;
+	int h_mode;
+	int h_poll_wait;
+	unsigned char h_content;
+	unsigned char h_contacts_mask;
+	int h_ready;				// the device's descriptor polled readable
+	int h_read_errors;			// reads failed in a row
+	unsigned long long h_next_read;	// usec the next read is due
+	t_sensel_clock h_clock;
+	short unsigned int h_led[SENSEL_LEDS];
+	short unsigned int h_thread_led[SENSEL_LEDS];	// as last written to the device
+	t_sensel_led_ramp h_ramp[SENSEL_LEDS];
+	int h_led_period;			// usec between LED writes at least
+	unsigned long long h_led_next;	// usec the next LED write may go out at
+	int h_led_busy;				// envelopes running or LEDs not written yet
+	unsigned short h_led_max;	// the device's full brightness
+	struct _sensel *h_subscribers;
+	int h_refs;					// number of subscribers
+	struct _sensel_hub *h_next;
+} t_sensel_hub;
+
+/*
+	Main Sensel Morph data structure
+*/
+typedef struct _sensel
+{
+	t_object x_obj;
+	t_atom x_atom;
+	t_canvas *x_canvas;
+
+	t_outlet *x_outlet_data;
+	t_outlet *x_outlet_status;
+	t_outlet *x_outlet_gesture;
+	t_outlet *x_outlet_accel;
+
+	// Sensel thread side of the device
+	t_sensel_hub *x_hub;		// NULL unless a device is open
+	struct _sensel *x_hub_next;	// the hub's other subscribers
+	int x_thread_open;
+	int x_thread_connected;
+	t_sensel_recorder *x_thread_recorder;
+	int x_thread_poll_wait;
+	int x_thread_led_period;
+	int x_thread_mode;
+	t_sensel_sim_config x_thread_sim;
+	int x_thread_pressure;
+	t_sensel_process x_thread_process;
+	int x_thread_format;
+	int x_thread_fields[SENSEL_FIELDS];	// indices of the selected fields
+	int x_thread_n_fields;
+	unsigned char x_thread_contacts_mask;
+	t_sensel_zones *x_thread_zones;	// NULL to output every contact
+	unsigned char x_thread_contact_zone[256];	// per contact id, index + 1
+	float x_thread_deadband[SENSEL_DEADBANDS];
+	t_sensel_deadband x_thread_last[256];	// per contact id
+	t_sensel_filter x_thread_filter;
+	t_sensel_track x_thread_track[256];		// per contact id
+	t_sensel_gestures x_thread_gestures;
+	int x_thread_accel_frames;	// frames averaged, 0 for no accelerometer
+	float x_thread_accel_threshold;
+	int x_thread_accel_count;	// frames summed so far
+	float x_thread_accel_sum[3];
+	float x_thread_accel_last[3];	// as last output
+	int x_thread_accel_valid;
+	int x_thread_blobs;
+	t_sensel_blob x_thread_blob[256];	// per label, reset after every frame
+	int x_thread_hotplug;
+	char x_thread_lost[64];		// serial of the unplugged device to reopen, or ""
+	t_sensel_stats x_thread_stats;
+
+	// Pd side of the device
+	int x_connected;
+	int x_connecting;
+	int x_recording;
+	t_symbol *x_serial;
+	t_symbol *x_pressure;
+	t_symbol *x_pressure_rows;
+	t_symbol *x_pressure_cols;
+	t_symbol *x_led_array;		// LED table, NULL for none
+	int x_led_warned;
+	double x_led_period;		// msec between copies of the LED table
+	int x_pressure_warned;		// one bit per array
+	double x_latency;			// msec from a frame's timestamp to its output, 0 = at once
+	double x_logical;			// Pd's logical minus monotonic msec
+	int x_logical_valid;
+	t_sensel_zones *x_zones;	// NULL until the first zone is set
+	t_sensel_histogram x_stats_latency;	// usec from a frame's read to its output
+	unsigned int x_stats_frames;	// frames read at the last "stats"
+	unsigned long long x_stats_time;	// usec of the last "stats"
+
+	int x_attached;				// known to the I/O thread
+	atomic_int x_detached;		// the I/O thread is done with the object
+	struct _sensel *x_thread_next;	// objects served by the I/O thread
+	t_sensel_queue x_commands;
+	t_sensel_queue x_replies;
+
+	t_sensel_ring x_ring;
+	t_sensel_image x_image;
+	t_sensel_snapshot x_snapshot;
+	t_atom *x_out_args;
+	int x_out_size;
+	unsigned int x_overflow_reported;
+	int x_n_contacts;
+
+	t_clock *x_clock_output;	// scheduled by the Sensel thread only
+	atomic_int x_clock_set;
+	t_clock *x_clock_latency;	// frames held back, scheduled by the Pd thread only
+	t_clock *x_clock_reply;
+	atomic_int x_reply_set;
+	t_clock *x_clock_leds;
+
+	// the LED table as last copied by the Pd thread, in
+	// SENSEL_LED_TABLE_FULL parts of full brightness (-1 for
+	// LEDs beyond the table), and what the thread made of it
+	atomic_int x_led_table[SENSEL_LEDS];
+	atomic_int x_led_table_set;
+	int x_thread_led_table[SENSEL_LEDS];
+
+	struct _sensel *x_next;		// all [sensel] objects, for [sensel~]
+} t_sensel;
+
+static t_sensel *sensel_objects;
+
+/*
+	The Sensel thread: one I/O thread serves every [sensel]
+	object, waiting on all their devices at once. It is started
+	by the first command that needs it (connecting, say) and
+	exits once no device is open, none is waited for to be
+	plugged back in and there is nothing left to do, to be
+	started afresh by the next such command.
+
+	Objects are handed over to it on their first command and
+	taken back when freed through the r_events queue, so the
+	list of objects it serves is its own and never locked. Only
+	starting and stopping take r_mutex: the thread clears
+	r_running before its final look at the queues, and the Pd
+	thread reads r_running after queuing, so one of the two
+	always sees the other.
+*/
+#define SENSEL_REACTOR_ATTACH		0	// start serving e_object
+#define SENSEL_REACTOR_DETACH		1	// close e_object's device and let go of it
+
+#define SENSEL_REACTOR_EVENTS		256
+#define SENSEL_REACTOR_IDLE			100000	// usec to wait with no device due
+#define SENSEL_REACTOR_WATCH		1000000	// usec between lists of devices while watching
+#define SENSEL_REACTOR_WATCH_STEP	10000	// usec the watcher sleeps between checks it is wanted
+#define SENSEL_LOST_READS			20		// reads failed in a row that mean unplugged
+
+typedef struct _sensel_reactor_event
+{
+	int e_type;
+	t_sensel *e_object;
+} t_sensel_reactor_event;
+
+typedef struct _sensel_reactor
+{
+	pthread_t r_thread;
+	int r_started;				// r_thread is yet to be joined
+	atomic_int r_running;
+	pthread_mutex_t r_mutex;
+	int r_wake[2];				// wakes the thread up for commands
+#ifdef WIN32
+	HANDLE r_wake_event;		// likewise on Windows, which has no pipe to poll()
+#endif
+	t_sensel_queue r_events;
+	t_sensel *r_objects;		// owned by the thread
+	t_sensel_hub *r_hubs;		// likewise
+	SenselDeviceList r_devices;	// the watcher's list last looked at
+	unsigned int r_listed;		// and its number
+	int r_watching;				// the watcher is wanted
+} t_sensel_reactor;
+
+static t_sensel_reactor sensel_reactor;
+
+/*
+	The watcher: listing the devices probes every serial port,
+	which takes long enough to stall the reads of every open
+	device, so it is done by a thread of its own, at a low
+	priority, while any object waits for an unplugged device to
+	come back. It lists them every SENSEL_REACTOR_WATCH and
+	hands each list over to the Sensel thread, which never lists
+	them itself for this. Only the Sensel thread starts and stops
+	it: w_wanted and w_running change under w_mutex, so a watcher
+	on its way out is never taken for one still running.
+*/
+typedef struct _sensel_watcher
+{
+	pthread_t w_thread;
+	int w_started;				// w_thread is yet to be joined
+	int w_running;				// under w_mutex
+	int w_wanted;				// likewise
+	pthread_mutex_t w_mutex;	// also guards w_devices
+	SenselDeviceList w_devices;	// as last listed
+	atomic_uint w_listed;		// lists taken so far
+} t_sensel_watcher;
+
+static t_sensel_watcher sensel_watcher = { .w_mutex = PTHREAD_MUTEX_INITIALIZER };
+
+/*
+	Forward declarations
+*/
+static void sensel_poll(t_sensel_hub *h);
+static void *sensel_reactor_thread(void *ptr);
+
+/*
+	Pd thread side: creates the reactor's queue and wakeup pipe
+*/
+static void sensel_reactor_init(void)
+{
+	sensel_reactor.r_started = 0;
+	atomic_init(&sensel_reactor.r_running, 0);
+	pthread_mutex_init(&sensel_reactor.r_mutex, NULL);
+	sensel_queue_alloc(&sensel_reactor.r_events, sizeof(t_sensel_reactor_event), SENSEL_REACTOR_EVENTS);
+	sensel_reactor.r_objects = NULL;
+	sensel_reactor.r_hubs = NULL;
+	sensel_reactor.r_devices.num_devices = 0;
+	sensel_reactor.r_listed = 0;
+	sensel_reactor.r_watching = 0;
+#ifndef WIN32
+	if (pipe(sensel_reactor.r_wake) == 0)
+	{
+		fcntl(sensel_reactor.r_wake[0], F_SETFL, O_NONBLOCK);
+		fcntl(sensel_reactor.r_wake[1], F_SETFL, O_NONBLOCK);
+	}
+	else
+	{
+		sensel_reactor.r_wake[0] = -1;
+		sensel_reactor.r_wake[1] = -1;
+	}
+#else
+	// auto-reset, so one wait takes one batch of wakeups
+	sensel_reactor.r_wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#endif
+}
+
+/*
+	Pd thread side: wakes the Sensel thread up for what was just
+	queued, starting it if start is set and it is not running
+*/
+static void sensel_reactor_wake(int start)
+{
+	// pairs with the fence in sensel_reactor_idle()
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load(&sensel_reactor.r_running))
+	{
+#ifndef WIN32
+		// the write end is non-blocking, a full pipe is already a wakeup
+		char c = 0;
+		if (write(sensel_reactor.r_wake[1], &c, 1) < 0) {}
+#else
+		if (sensel_reactor.r_wake_event != NULL)
+			SetEvent(sensel_reactor.r_wake_event);
+#endif
+	}
+	else if (start)
+	{
+		pthread_mutex_lock(&sensel_reactor.r_mutex);
+		if (!atomic_load(&sensel_reactor.r_running))
+		{
+			// a previous thread has decided to exit and does no more
+			if (sensel_reactor.r_started)
+				pthread_join(sensel_reactor.r_thread, NULL);
+			atomic_store(&sensel_reactor.r_running, 1);
+			sensel_reactor.r_started = (pthread_create(&sensel_reactor.r_thread, NULL,
+				sensel_reactor_thread, NULL) == 0);
+			if (!sensel_reactor.r_started)
+			{
+				atomic_store(&sensel_reactor.r_running, 0);
+				error("sensel: failed to start the device thread.");
+			}
+		}
+		pthread_mutex_unlock(&sensel_reactor.r_mutex);
+	}
+}
+
+/*
+	Pd thread side: hands an object over to the Sensel thread or
+	takes it back, waiting for room if the thread is behind.
+	Taking it back needs the thread, handing it over does not.
+*/
+static void sensel_reactor_event(int type, t_sensel *x)
+{
+	t_sensel_reactor_event e;
+
+	e.e_type = type;
+	e.e_object = x;
+	while (sensel_queue_push(&sensel_reactor.r_events, &e) < 0)
+	{
+		sensel_reactor_wake(1);
+		usleep(1000);
+	}
+	sensel_reactor_wake(type == SENSEL_REACTOR_DETACH);
+}
+
+/*
+	Queues a command for the Sensel thread and wakes it up,
+	returning:
+		0 for success
+		-1 if the thread has fallen too far behind
+
+	Only commands that open a device or list them start the
+	thread, the others wait in the queue until it runs, unless
+	the queue is filling up.
+*/
+static int sensel_push_command(t_sensel *x, t_sensel_command *cmd)
+{
+	if (!x->x_attached)
+	{
+		sensel_reactor_event(SENSEL_REACTOR_ATTACH, x);
+		x->x_attached = 1;
+	}
+	if (sensel_queue_push(&x->x_commands, cmd) < 0)
+	{
+		error("sensel: command queue full--device thread is not responding.");
+		return(-1);
+	}
+	sensel_reactor_wake(cmd->c_type == SENSEL_COMMAND_CONNECT
+		|| cmd->c_type == SENSEL_COMMAND_DISCOVER
+		|| cmd->c_type == SENSEL_COMMAND_REPLAY
+		|| cmd->c_type == SENSEL_COMMAND_IDENTIFY
+		|| (cmd->c_type == SENSEL_COMMAND_HOTPLUG && cmd->c_value)
+		|| atomic_load_explicit(&x->x_commands.q_write, memory_order_relaxed)
+			- atomic_load_explicit(&x->x_commands.q_read, memory_order_relaxed)
+			> SENSEL_COMMAND_QUEUE_SIZE / 2);
+	return(0);
+}
+
+static int sensel_send_command(t_sensel *x, int type, int value, int value2, const char *text)
+{
+	t_sensel_command cmd;
+
+	cmd.c_type = type;
+	cmd.c_value = value;
+	cmd.c_value2 = value2;
+	cmd.c_float = 0;
+	cmd.c_pointer = NULL;
+	cmd.c_text[0] = '\0';
+	if (text != NULL)
+	{
+		strncpy(cmd.c_text, text, 63);
+		cmd.c_text[63] = '\0';
+	}
+	return(sensel_push_command(x, &cmd));
+}
+
+/*
+	Same as above, for commands that hand over heap data
+*/
+static int sensel_send_command_pointer(t_sensel *x, int type, void *pointer, float f)
+{
+	t_sensel_command cmd;
+
+	cmd.c_type = type;
+	cmd.c_value = 0;
+	cmd.c_value2 = 0;
+	cmd.c_float = f;
+	cmd.c_pointer = pointer;
+	cmd.c_text[0] = '\0';
+	return(sensel_push_command(x, &cmd));
+}
+
+static int sensel_send_command_float(t_sensel *x, int type, int value, float f)
+{
+	t_sensel_command cmd;
+
+	cmd.c_type = type;
+	cmd.c_value = value;
+	cmd.c_value2 = 0;
+	cmd.c_float = f;
+	cmd.c_pointer = NULL;
+	cmd.c_text[0] = '\0';
+	return(sensel_push_command(x, &cmd));
+}
+
+/*
+	Sensel thread side: queues a reply for the Pd thread and
+	schedules its processing
+*/
+static void sensel_push_reply(t_sensel *x, t_sensel_reply *reply)
+{
+	// the Pd thread drains replies every tick, so this only
+	// fails if Pd is stalled, in which case there is no one
+	// to tell anyway
+	sensel_queue_push(&x->x_replies, reply);
+	if (!atomic_exchange(&x->x_reply_set, 1))
+		clock_delay(x->x_clock_reply, 0);
+}
+
+static void sensel_send_reply(t_sensel *x, int type, int command, int value, const char *text)
+{
+	t_sensel_reply reply;
+
+	reply.r_type = type;
+	reply.r_command = command;
+	reply.r_value = value;
+	reply.r_value2 = 0;
+	reply.r_value3 = 0;
+	reply.r_text[0] = '\0';
+	if (text != NULL)
+	{
+		strncpy(reply.r_text, text, 63);
+		reply.r_text[63] = '\0';
+	}
+	sensel_push_reply(x, &reply);
+}
+
+/*
+	Allows adjustment of the wait time
+	in between poll reads from the Sensel socket
+*/
+static void sensel_set_poll_wait_time(t_sensel *x, t_floatarg f)
+{
+	if (f < 1.0 || f > 100.0)
+	{
+		error("sensel: poll time must be between 1 and 100ms (default 10ms).");
+		return;
+	}
+	sensel_send_command(x, SENSEL_COMMAND_POLL, (int)(f * 1000.0), 0, NULL);
+}
+
+/*
+	Selects how the thread waits for new data: "poll" sleeps
+	for the poll time between reads, "event" blocks on the
+	device's serial port and reads as soon as data arrives
+*/
+static void sensel_set_mode(t_sensel *x, t_symbol *s)
+{
+	if (s == gensym("poll"))
+		sensel_send_command(x, SENSEL_COMMAND_MODE, SENSEL_MODE_POLL, 0, NULL);
+	else if (s == gensym("event"))
+	{
+#ifdef WIN32
+		error("sensel: event mode is not supported on Windows, using poll mode.");
+		sensel_send_command(x, SENSEL_COMMAND_MODE, SENSEL_MODE_POLL, 0, NULL);
+#else
+		sensel_send_command(x, SENSEL_COMMAND_MODE, SENSEL_MODE_EVENT, 0, NULL);
+#endif
+	}
+	else
+		error("sensel: mode must be either poll or event (default poll).");
+}
+
+/*
+	Configures the simulated device used by "connect sim:<script>":
+	"sim contacts <n>", "sim rate <fps>", "sim noise <grams>",
+	"sim seed <n>" and "sim skew <ppm>". Changes apply to a
+	running simulation as well.
+*/
+static void sensel_set_sim(t_sensel *x, t_symbol *s, t_floatarg f)
+{
+	int param;
+
+	if (s == gensym("contacts"))
+		param = SENSEL_SIM_PARAM_CONTACTS;
+	else if (s == gensym("rate"))
+		param = SENSEL_SIM_PARAM_RATE;
+	else if (s == gensym("noise"))
+		param = SENSEL_SIM_PARAM_NOISE;
+	else if (s == gensym("seed"))
+		param = SENSEL_SIM_PARAM_SEED;
+	else if (s == gensym("skew"))
+		param = SENSEL_SIM_PARAM_SKEW;
+	else
+	{
+		error("sensel: sim parameter must be contacts, rate, noise, seed or skew.");
+		return;
+	}
+	sensel_send_command(x, SENSEL_COMMAND_SIM, param, (int)f, NULL);
+}
+
+/*
+	A time in msec, as a float or a symbol such as "250ms",
+	returning -1 if it is neither
+*/
+static float sensel_led_time(const t_atom *a)
+{
+	char *end;
+	float f;
+
+	if (a->a_type == A_FLOAT)
+		return(a->a_w.w_float >= 0 ? a->a_w.w_float : -1);
+	if (a->a_type != A_SYMBOL)
+		return(-1);
+	f = strtof(a->a_w.w_symbol->s_name, &end);
+	if (end == a->a_w.w_symbol->s_name || strcmp(end, "ms") || f < 0)
+		return(-1);
+	return(f);
+}
+
+/*
+	Sets Sensel's LED with an ID (or "all" of them) to a desired
+	brightness in (0-100), at once or ramping there in msec,
+	optionally followed by further brightness and time pairs
+	that make up an envelope: "led <id> <brightness> [<ms>
+	[<brightness> <ms> ...]]"
+*/
+static void sensel_set_led(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	int id = -1, n = argc / 2;
+	float brightness[SENSEL_LED_SEGMENTS], ms[SENSEL_LED_SEGMENTS];
+	(void)s;
+
+	if (argc < 2 || n > SENSEL_LED_SEGMENTS)
+	{
+		error("sensel: led needs an id, a brightness and at most %d ramps.", SENSEL_LED_SEGMENTS);
+		return;
+	}
+	if (argv[0].a_type == A_FLOAT)
+		id = (int)argv[0].a_w.w_float;
+	if (!(argv[0].a_type == A_SYMBOL && argv[0].a_w.w_symbol == gensym("all"))
+		&& (argv[0].a_type != A_FLOAT || id < 0 || id >= SENSEL_LEDS))
+	{
+		error("sensel: led id must be between 0 and %d or all.", SENSEL_LEDS - 1);
+		return;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		brightness[i] = atom_getfloatarg(1 + 2 * i, argc, argv);
+		ms[i] = (2 + 2 * i < argc ? sensel_led_time(&argv[2 + 2 * i]) : 0);
+		if (brightness[i] < 0 || brightness[i] > 100 || ms[i] < 0)
+		{
+			error("sensel: led brightness must be between 0 and 100 and ramps at least 0 ms.");
+			return;
+		}
+	}
+	if (x->x_connected == 1)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			t_sensel_command cmd;
+
+			cmd.c_type = (i == 0 ? SENSEL_COMMAND_LED : SENSEL_COMMAND_LED_SEGMENT);
+			cmd.c_value = id;
+			cmd.c_value2 = (int)brightness[i];
+			cmd.c_float = ms[i];
+			cmd.c_pointer = NULL;
+			cmd.c_text[0] = '\0';
+			sensel_push_command(x, &cmd);
+		}
+	}
+}
+
+/*
+	Sets how often the LEDs may be written at most, per second
+*/
+static void sensel_set_led_rate(t_sensel *x, t_floatarg f)
+{
+	if (f < 1 || f > SENSEL_LED_RATE_MAX)
+	{
+		error("sensel: ledrate has to be between 1 and %d per second.", SENSEL_LED_RATE_MAX);
+		return;
+	}
+	x->x_led_period = 1000.0 / f;
+	sensel_send_command(x, SENSEL_COMMAND_LED_RATE, (int)(1000000 / f), 0, NULL);
+}
+
+/*
+	Copies the LED table for the Sensel thread, once per LED
+	period. The array is only ever touched by the Pd thread,
+	which may resize or delete it at any time; the thread only
+	sees the copy, and only when something changed.
+*/
+static void sensel_sample_leds(t_sensel *x)
+{
+	t_garray *array;
+	t_word *vec;
+	int size, changed = 0;
+
+	if (x->x_led_array == NULL)
+		return;
+	clock_delay(x->x_clock_leds, x->x_led_period);
+	if ((array = (t_garray *)pd_findbyclass(x->x_led_array, garray_class)) == NULL
+		|| !garray_getfloatwords(array, &size, &vec))
+	{
+		if (!x->x_led_warned)
+			error("sensel: ledarray: no float array named %s.", x->x_led_array->s_name);
+		x->x_led_warned = 1;
+		return;
+	}
+	x->x_led_warned = 0;
+	for (int i = 0; i < SENSEL_LEDS; i++)
+	{
+		int value = -1;
+
+		if (i < size)
+		{
+			t_float f = vec[i].w_float;
+			value = (int)((f < 0 ? 0 : (f > 1 ? 1 : f)) * SENSEL_LED_TABLE_FULL + 0.5f);
+		}
+		if (value != atomic_load_explicit(&x->x_led_table[i], memory_order_relaxed))
+		{
+			atomic_store_explicit(&x->x_led_table[i], value, memory_order_relaxed);
+			changed = 1;
+		}
+	}
+	if (changed)
+		atomic_store_explicit(&x->x_led_table_set, 1, memory_order_release);
+}
+
+/*
+	Binds the LEDs to a table of 24 values from 0 (off) to 1
+	(full brightness), "ledarray" alone lets go of it
+*/
+static void sensel_set_led_array(t_sensel *x, t_symbol *s)
+{
+	if (*s->s_name == '\0')
+	{
+		x->x_led_array = NULL;
+		clock_unset(x->x_clock_leds);
+		return;
+	}
+	x->x_led_array = s;
+	x->x_led_warned = 0;
+	sensel_sample_leds(x);
+}
+
+/*
+	Sensel thread side: takes on the LEDs of an object's table
+	that changed since the thread last looked, scaled to the
+	device's full brightness. They stop any envelope running.
+*/
+static void sensel_thread_led_table(t_sensel *x, t_sensel_hub *h)
+{
+	for (int i = 0; i < SENSEL_LEDS; i++)
+	{
+		int value = atomic_load_explicit(&x->x_led_table[i], memory_order_relaxed);
+
+		if (value < 0 || value == x->x_thread_led_table[i])
+			continue;
+		x->x_thread_led_table[i] = value;
+		h->h_ramp[i].r_n = 0;
+		h->h_led[i] = (unsigned short)(((unsigned int)value * h->h_led_max
+			+ SENSEL_LED_TABLE_FULL / 2) / SENSEL_LED_TABLE_FULL);
+		h->h_led_busy = 1;
+	}
+}
+
+/*
+	Processes changes in LEDs via subthread call: runs the
+	envelopes and writes all LEDs in one go if any changed, at
+	most once per LED period, so animations cost no more USB
+	time than a single LED did
+*/
+static void sensel_update_leds(t_sensel_hub *h, unsigned long long now)
+{
+	int running = 0, changed = 0;
+
+	for (t_sensel *x = h->h_subscribers; x != NULL; x = x->x_hub_next)
+		if (atomic_exchange_explicit(&x->x_led_table_set, 0, memory_order_acquire))
+			sensel_thread_led_table(x, h);
+	if (!h->h_led_busy || now < h->h_led_next)
+		return;
+	for (int i = 0; i < SENSEL_LEDS; i++)
+	{
+		if (h->h_ramp[i].r_n > 0)
+			running |= sensel_led_ramp_run(&h->h_ramp[i], &h->h_led[i], now);
+		if (h->h_led[i] != h->h_thread_led[i])
+			changed = 1;
+	}
+	if (changed)
+	{
+		memcpy(h->h_thread_led, h->h_led, sizeof(h->h_thread_led));
+		h->h_backend->b_set_leds(h->h_handle, h->h_thread_led, SENSEL_LEDS);
+	}
+	h->h_led_next = now + h->h_led_period;
+	h->h_led_busy = running;
+}
+
+/*
+	Sensel thread side: the frame content an object needs
+*/
+static unsigned char sensel_thread_content(t_sensel *x)
+{
+	unsigned char content = FRAME_CONTENT_CONTACTS_MASK;
+
+	if (x->x_thread_pressure > 0 || x->x_thread_process.p_rows || x->x_thread_process.p_cols)
+		content |= FRAME_CONTENT_PRESSURE_MASK;
+	if (x->x_thread_accel_frames > 0)
+		content |= FRAME_CONTENT_ACCEL_MASK;
+	if (x->x_thread_blobs)
+		content |= FRAME_CONTENT_LABELS_MASK | FRAME_CONTENT_PRESSURE_MASK;
+	return(content);
+}
+
+/*
+	Sensel thread side: merges the subscribers' settings into the
+	device's and applies whatever changed
+*/
+static void sensel_hub_configure(t_sensel_hub *h)
+{
+	int content = FRAME_CONTENT_CONTACTS_MASK, mask = 0;
+	int mode = SENSEL_MODE_POLL, poll_wait = 0, led_period = 0;
+
+	for (t_sensel *x = h->h_subscribers; x != NULL; x = x->x_hub_next)
+	{
+		content |= sensel_thread_content(x);
+		mask |= x->x_thread_contacts_mask;
+		if (x->x_thread_mode == SENSEL_MODE_EVENT)
+			mode = SENSEL_MODE_EVENT;
+		if (poll_wait == 0 || x->x_thread_poll_wait < poll_wait)
+			poll_wait = x->x_thread_poll_wait;
+		if (led_period == 0 || x->x_thread_led_period < led_period)
+			led_period = x->x_thread_led_period;
+	}
+
+	if (content != h->h_content)
+	{
+		// the device only changes its content between scans
+		if (h->h_scanning)
+			h->h_backend->b_stop_scanning(h->h_handle);
+		h->h_backend->b_set_frame_content(h->h_handle, content);
+		if (h->h_scanning)
+			h->h_backend->b_start_scanning(h->h_handle);
+		h->h_content = content;
+	}
+	// the device stops sending the groups nobody needs
+	if (mask != h->h_contacts_mask)
+	{
+		h->h_backend->b_set_contacts_mask(h->h_handle, mask);
+		h->h_contacts_mask = mask;
+	}
+	// the device streams frames in event mode only, and goes
+	// back to sending them when read once nobody wants events
+	if (h->h_scanning && mode == SENSEL_MODE_EVENT && h->h_mode != SENSEL_MODE_EVENT)
+		h->h_backend->b_set_scan_mode(h->h_handle, SCAN_MODE_ASYNC);
+	else if (h->h_scanning && mode != SENSEL_MODE_EVENT && h->h_mode == SENSEL_MODE_EVENT)
+		h->h_backend->b_set_scan_mode(h->h_handle, SCAN_MODE_SYNC);
+	h->h_mode = mode;
+	if (poll_wait > 0)
+		h->h_poll_wait = poll_wait;
+	if (led_period > 0)
+		h->h_led_period = led_period;
+}
+
+/*
+	Sensel thread side: the open device with a serial number
+*/
+static t_sensel_hub *sensel_hub_find(const char *serial)
+{
+	for (t_sensel_hub *h = sensel_reactor.r_hubs; h != NULL; h = h->h_next)
+		if (!strcmp(h->h_serial, serial))
+			return(h);
+	return(NULL);
+}
+
+/*
+	Sensel thread side: opens the requested device (or the first
+	one not used by another sensel object) for x, returning the
+	new hub, or NULL once the error has been sent to x
+*/
+static t_sensel_hub *sensel_hub_open(t_sensel *x, t_sensel_command *cmd)
+{
+	// List of all available Sensel devices
+	SenselDeviceList list;
+	SenselSensorInfo info;
+	SENSEL_HANDLE handle;
+	const t_sensel_backend *backend;
+	char serial[64];
+	t_sensel_hub *h;
+	int i;
+
+	if (cmd->c_type == SENSEL_COMMAND_REPLAY)
+	{
+		const char *path = (const char *)cmd->c_pointer;
+		const char *name = strrchr(path, '/');
+		name = (name != NULL ? name + 1 : path);
+
+		if (sensel_replay_open(&handle, path, cmd->c_float) != SENSEL_OK)
+		{
+			sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_BAD_FILE, name);
+			return(NULL);
+		}
+		backend = &sensel_replay_backend;
+		snprintf(serial, 64, "%s%s", SENSEL_REPLAY_PREFIX, name);
+	}
+	else if (cmd->c_type == SENSEL_COMMAND_CONNECT
+		&& !strncmp(cmd->c_text, SENSEL_SIM_PREFIX, strlen(SENSEL_SIM_PREFIX)))
+	{
+		// simulated devices share the table so their names stay unique
+		if (add_connected_to_sensel_device_list(cmd->c_text) < 0)
+		{
+			sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_IN_USE, cmd->c_text);
+			return(NULL);
+		}
+		if (sensel_sim_open(&handle, cmd->c_text, &x->x_thread_sim) != SENSEL_OK)
+		{
+			remove_connected_to_sensel_device_list(cmd->c_text);
+			sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_NOT_FOUND, cmd->c_text);
+			return(NULL);
+		}
+		backend = &sensel_sim_backend;
+		strcpy(serial, cmd->c_text);
+	}
+	else
+	{
+		// Get a list of available Sensel devices, unless the
+		// watcher has just listed the one to reopen
+		if (cmd->c_type != SENSEL_COMMAND_HOTPLUG)
+		{
+			senselGetDeviceList(&list);
+			if (list.num_devices == 0)
+			{
+				sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_NO_DEVICE, cmd->c_text);
+				return(NULL);
+			}
+		}
+
+		if (cmd->c_type == SENSEL_COMMAND_CONNECT || cmd->c_type == SENSEL_COMMAND_HOTPLUG)
+		{
+			if (add_connected_to_sensel_device_list(cmd->c_text) < 0)
+			{
+				sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_IN_USE, cmd->c_text);
+				return(NULL);
+			}
+			if (senselOpenDeviceBySerialNum(&handle, (unsigned char *)cmd->c_text) != SENSEL_OK)
+			{
+				remove_connected_to_sensel_device_list(cmd->c_text);
+				sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_NOT_FOUND, cmd->c_text);
+				return(NULL);
+			}
+			strcpy(serial, cmd->c_text);
+		}
+		else
+		{
+			for (i = 0; i < list.num_devices; i++)
+			{
+				if (!add_connected_to_sensel_device_list((const char *)list.devices[i].serial_num))
+					break;
+			}
+			if (i == list.num_devices)
+			{
+				sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_ALL_IN_USE, NULL);
+				return(NULL);
+			}
+			// Open a Sensel device by the id in the SenselDeviceList, handle initialized
+			if (senselOpenDeviceByID(&handle, list.devices[i].idx) != SENSEL_OK)
+			{
+				remove_connected_to_sensel_device_list((const char *)list.devices[i].serial_num);
+				sensel_send_reply(x, SENSEL_REPLY_ERROR, cmd->c_type, SENSEL_ERROR_NOT_FOUND,
+					(const char *)list.devices[i].serial_num);
+				return(NULL);
+			}
+			strncpy(serial, (const char *)list.devices[i].serial_num, 63);
+			serial[63] = '\0';
+		}
+		backend = &sensel_vendor_backend;
+	}
+
+	h = (t_sensel_hub *)getbytes(sizeof(t_sensel_hub));
+	h->h_backend = backend;
+	h->h_handle = handle;
+	strcpy(h->h_serial, serial);
+
+	// Set the frame content to scan contact (and force) data
+	h->h_content = sensel_thread_content(x);
+	h->h_contacts_mask = x->x_thread_contacts_mask;
+	backend->b_set_frame_content(handle, h->h_content);
+	backend->b_set_contacts_mask(handle, h->h_contacts_mask);
+	// Allocate a frame of data, must be done before reading frame data
+	backend->b_allocate_frame_data(handle, &h->h_frame);
+
+	if (backend->b_get_sensor_info(handle, &info) != SENSEL_OK || info.max_contacts == 0)
+		info.max_contacts = 16;
+	h->h_info = info;
+
+	// a freshly opened device starts dark and in its default scan mode
+	for (i = 0; i < SENSEL_LEDS; i++)
+	{
+		h->h_led[i] = 0;
+		h->h_thread_led[i] = 0;
+		h->h_ramp[i].r_n = 0;
+	}
+	h->h_led_period = x->x_thread_led_period;
+	h->h_led_next = 0;
+	h->h_led_busy = 0;
+	if (backend->b_get_max_led_brightness(handle, &h->h_led_max) != SENSEL_OK || h->h_led_max == 0)
+		h->h_led_max = SENSEL_LED_PERCENT;
+	h->h_scanning = 0;
+	h->h_mode = x->x_thread_mode;
+	h->h_poll_wait = x->x_thread_poll_wait;
+	h->h_ready = 0;
+	h->h_read_errors = 0;
+	h->h_next_read = 0;
+	sensel_clock_reset(&h->h_clock);
+	h->h_subscribers = NULL;
+	h->h_refs = 0;
+	h->h_next = sensel_reactor.r_hubs;
+	sensel_reactor.r_hubs = h;
+	return(h);
+}
+
+/*
+	Sensel thread side: stops scanning and closes the device
+*/
+static void sensel_hub_close(t_sensel_hub *h)
+{
+	// This is where we stop scanning and disconnect
+	if (h->h_scanning)
+		h->h_backend->b_stop_scanning(h->h_handle);
+	h->h_backend->b_free_frame_data(h->h_handle, h->h_frame);
+	h->h_backend->b_close(h->h_handle);
+	remove_connected_to_sensel_device_list(h->h_serial);
+	for (t_sensel_hub **s = &sensel_reactor.r_hubs; *s != NULL; s = &(*s)->h_next)
+	{
+		if (*s == h)
+		{
+			*s = h->h_next;
+			break;
+		}
+	}
+	freebytes(h, sizeof(t_sensel_hub));
+}
+
+/*
+	Sensel thread side: makes x a subscriber of the device. The
+	output is sized for the contacts and the force image, then
+	scanning starts once the Pd thread has sized the output ring
+	and sent SENSEL_COMMAND_START.
+*/
+static void sensel_hub_subscribe(t_sensel_hub *h, t_sensel *x, int command)
+{
+	t_sensel_reply reply;
+
+	x->x_hub = h;
+	x->x_hub_next = h->h_subscribers;
+	h->h_subscribers = x;
+	h->h_refs++;
+	sensel_process_alloc(&x->x_thread_process, h->h_info.num_rows * h->h_info.num_cols);
+	if (x->x_thread_zones != NULL)
+		sensel_zones_index(x->x_thread_zones, &h->h_info);
+	memset(x->x_thread_contact_zone, SENSEL_ZONE_UNKNOWN, sizeof(x->x_thread_contact_zone));
+	for (int i = 0; i < 256; i++)
+	{
+		x->x_thread_last[i].d_valid = 0;
+		x->x_thread_track[i].t_valid = 0;
+	}
+	sensel_gestures_reset(&x->x_thread_gestures);
+	x->x_thread_accel_count = 0;
+	x->x_thread_accel_valid = 0;
+	// a table set before connecting lights the device up at once
+	for (int i = 0; i < SENSEL_LEDS; i++)
+		x->x_thread_led_table[i] = -1;
+	atomic_store_explicit(&x->x_led_table_set, 1, memory_order_release);
+	x->x_n_contacts = 0;
+	x->x_thread_open = 1;
+	x->x_thread_lost[0] = '\0';
+	sensel_hub_configure(h);
+
+	reply.r_type = SENSEL_REPLY_CONNECTED;
+	reply.r_command = command;
+	reply.r_value = h->h_info.max_contacts;
+	reply.r_value2 = h->h_info.num_rows;
+	reply.r_value3 = h->h_info.num_cols;
+	strcpy(reply.r_text, h->h_serial);
+	sensel_push_reply(x, &reply);
+}
+
+/*
+	Sensel thread side: connects x to the requested device,
+	sharing it if another sensel object has it open already
+*/
+static void sensel_thread_open(t_sensel *x, t_sensel_command *cmd)
+{
+	t_sensel_hub *h = NULL;
+
+	if (x->x_thread_open)
+	{
+		// the Pd side already refuses this, so just keep going
+		return;
+	}
+	if (cmd->c_type == SENSEL_COMMAND_CONNECT || cmd->c_type == SENSEL_COMMAND_HOTPLUG)
+		h = sensel_hub_find(cmd->c_text);
+	if (h == NULL)
+		h = sensel_hub_open(x, cmd);
+	if (h != NULL)
+		sensel_hub_subscribe(h, x, cmd->c_type);
+}
+
+/*
+	Sensel thread side: starts scanning once the output is ready
+*/
+static void sensel_thread_start(t_sensel *x)
+{
+	if (x->x_thread_open && !x->x_thread_connected)
+	{
+		t_sensel_hub *h = x->x_hub;
+
+		if (!h->h_scanning)
+		{
+			// in event mode the device has to push frames on its own
+			if (h->h_mode == SENSEL_MODE_EVENT)
+				h->h_backend->b_set_scan_mode(h->h_handle, SCAN_MODE_ASYNC);
+			// Start scanning the Sensel device
+			h->h_backend->b_start_scanning(h->h_handle);
+			h->h_scanning = 1;
+			h->h_next_read = 0;
+		}
+		x->x_thread_connected = 1;
+	}
+}
+
+/*
+	Sensel thread side: stops a recording in progress, if any
+*/
+static void sensel_thread_stop_recording(t_sensel *x)
+{
+	t_sensel_reply reply;
+
+	if (x->x_thread_recorder != NULL)
+	{
+		reply.r_type = SENSEL_REPLY_RECORDED;
+		reply.r_command = SENSEL_COMMAND_STOP;
+		reply.r_value = x->x_thread_recorder->r_frames;
+		reply.r_value2 = x->x_thread_recorder->r_dropped;
+		reply.r_value3 = atomic_load_explicit(&x->x_thread_recorder->r_failed, memory_order_relaxed);
+		reply.r_text[0] = '\0';
+		sensel_recorder_detach(x->x_thread_recorder);
+		x->x_thread_recorder = NULL;
+		sensel_push_reply(x, &reply);
+	}
+}
+
+/*
+	Sensel thread side: lets go of the device, which is closed
+	once no other sensel object is using it
+*/
+static void sensel_thread_close(t_sensel *x)
+{
+	sensel_thread_stop_recording(x);
+
+	if (x->x_thread_open)
+	{
+		t_sensel_hub *h = x->x_hub;
+
+		for (t_sensel **s = &h->h_subscribers; *s != NULL; s = &(*s)->x_hub_next)
+		{
+			if (*s == x)
+			{
+				*s = x->x_hub_next;
+				break;
+			}
+		}
+		sensel_process_free(&x->x_thread_process);
+		x->x_hub = NULL;
+		x->x_thread_connected = 0;
+		x->x_thread_open = 0;
+		if (--h->h_refs == 0)
+			sensel_hub_close(h);
+		else
+			sensel_hub_configure(h);
+	}
+}
+
+/*
+	Sensel thread side: lists all available devices
+*/
+static void sensel_thread_identify(t_sensel *x)
+{
+	// List of all available Sensel devices
+	SenselDeviceList list;
+
+	// Get a list of available Sensel devices
+	senselGetDeviceList(&list);
+	sensel_send_reply(x, SENSEL_REPLY_IDENTIFY, SENSEL_COMMAND_IDENTIFY, list.num_devices, NULL);
+	for (int i = 0; i < list.num_devices; i++)
+	{
+		sensel_send_reply(x, SENSEL_REPLY_DEVICE, SENSEL_COMMAND_IDENTIFY, i + 1,
+			(const char *)list.devices[i].serial_num);
+	}
+}
+
+/*
+	Sensel thread side: executes all commands queued by the Pd thread
+*/
+static void sensel_thread_commands(t_sensel *x)
+{
+	t_sensel_command cmd;
+
+	while (!sensel_queue_pop(&x->x_commands, &cmd))
+	{
+		switch (cmd.c_type)
+		{
+			case SENSEL_COMMAND_CONNECT:
+			case SENSEL_COMMAND_DISCOVER:
+				sensel_thread_open(x, &cmd);
+				break;
+			case SENSEL_COMMAND_REPLAY:
+				sensel_thread_open(x, &cmd);
+				freebytes(cmd.c_pointer, strlen((char *)cmd.c_pointer) + 1);
+				break;
+			case SENSEL_COMMAND_RECORD:
+				sensel_thread_stop_recording(x);
+				x->x_thread_recorder = (t_sensel_recorder *)cmd.c_pointer;
+				if (x->x_thread_open)
+					sensel_recorder_attach(x->x_thread_recorder, &x->x_hub->h_info);
+				else
+				{
+					const SenselSensorInfo none = { 0 };
+					sensel_recorder_attach(x->x_thread_recorder, &none);
+					sensel_thread_stop_recording(x);
+				}
+				break;
+			case SENSEL_COMMAND_STOP:
+				sensel_thread_stop_recording(x);
+				break;
+			case SENSEL_COMMAND_START:
+				sensel_thread_start(x);
+				break;
+			case SENSEL_COMMAND_DISCONNECT:
+				// an unplugged device is not waited for any longer either
+				x->x_thread_lost[0] = '\0';
+				if (x->x_thread_open)
+				{
+					sensel_thread_close(x);
+					sensel_send_reply(x, SENSEL_REPLY_DISCONNECTED, cmd.c_type, 0, NULL);
+				}
+				break;
+			case SENSEL_COMMAND_IDENTIFY:
+				sensel_thread_identify(x);
+				break;
+			case SENSEL_COMMAND_LED:
+			case SENSEL_COMMAND_LED_SEGMENT:
+				// the LEDs belong to the device, so the last to set one wins
+				if (x->x_thread_open)
+				{
+					t_sensel_hub *h = x->x_hub;
+					unsigned long long now = sensel_monotonic_usec();
+
+					unsigned short target = (unsigned short)((cmd.c_value2 * h->h_led_max
+						+ SENSEL_LED_PERCENT / 2) / SENSEL_LED_PERCENT);
+
+					for (int i = 0; i < SENSEL_LEDS; i++)
+						if (cmd.c_value < 0 || cmd.c_value == i)
+							sensel_led_ramp_add(&h->h_ramp[i], (cmd.c_type == SENSEL_COMMAND_LED),
+								h->h_led[i], target, (unsigned int)(cmd.c_float * 1000), now);
+					h->h_led_busy = 1;
+				}
+				break;
+			case SENSEL_COMMAND_LED_RATE:
+				x->x_thread_led_period = cmd.c_value;
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_POLL:
+				x->x_thread_poll_wait = cmd.c_value;
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_MODE:
+				x->x_thread_mode = cmd.c_value;
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_SIM:
+				// applies to the running simulation and the next one
+				sensel_sim_set_param(&x->x_thread_sim, cmd.c_value, cmd.c_value2);
+				if (x->x_thread_open && x->x_hub->h_backend == &sensel_sim_backend)
+					x->x_hub->h_backend->b_configure(x->x_hub->h_handle, cmd.c_value, cmd.c_value2);
+				break;
+			case SENSEL_COMMAND_PRESSURE:
+				x->x_thread_pressure = cmd.c_value;
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_IMAGE:
+				sensel_process_set(&x->x_thread_process, cmd.c_value, cmd.c_float);
+				if (x->x_thread_open && (cmd.c_value == SENSEL_IMAGE_ROWS
+					|| cmd.c_value == SENSEL_IMAGE_COLS || cmd.c_value == SENSEL_IMAGE_RESET))
+				{
+					sensel_hub_configure(x->x_hub);
+				}
+				break;
+			case SENSEL_COMMAND_FORMAT:
+				x->x_thread_format = cmd.c_value;
+				break;
+			case SENSEL_COMMAND_FIELDS:
+				x->x_thread_n_fields = 0;
+				for (int i = 0; i < SENSEL_FIELDS; i++)
+					if (cmd.c_value & (1 << i))
+						x->x_thread_fields[x->x_thread_n_fields++] = i;
+				x->x_thread_contacts_mask = sensel_contacts_mask(cmd.c_value);
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_SEEK:
+				if (x->x_thread_open && x->x_hub->h_backend == &sensel_replay_backend)
+					x->x_hub->h_backend->b_configure(x->x_hub->h_handle, SENSEL_REPLAY_SEEK, cmd.c_value);
+				break;
+			case SENSEL_COMMAND_STATS:
+				sensel_stats_reset(&x->x_thread_stats);
+				break;
+			case SENSEL_COMMAND_ZONES:
+				if (x->x_thread_zones != NULL)
+					freebytes(x->x_thread_zones, sizeof(t_sensel_zones));
+				x->x_thread_zones = (t_sensel_zones *)cmd.c_pointer;
+				if (x->x_thread_zones != NULL && x->x_thread_open)
+					sensel_zones_index(x->x_thread_zones, &x->x_hub->h_info);
+				// contacts already down are classified where they are now
+				memset(x->x_thread_contact_zone, SENSEL_ZONE_UNKNOWN, sizeof(x->x_thread_contact_zone));
+				break;
+			case SENSEL_COMMAND_FILTER:
+				sensel_filter_set(&x->x_thread_filter, cmd.c_value, cmd.c_float);
+				// contacts already down start filtering afresh
+				for (int i = 0; i < 256; i++)
+					x->x_thread_track[i].t_valid = 0;
+				break;
+			case SENSEL_COMMAND_ACCEL:
+				x->x_thread_accel_frames = cmd.c_value;
+				x->x_thread_accel_threshold = cmd.c_float;
+				x->x_thread_accel_count = 0;
+				x->x_thread_accel_valid = 0;
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_BLOBS:
+				x->x_thread_blobs = cmd.c_value;
+				if (x->x_thread_open)
+					sensel_hub_configure(x->x_hub);
+				break;
+			case SENSEL_COMMAND_HOTPLUG:
+				x->x_thread_hotplug = cmd.c_value;
+				break;
+			case SENSEL_COMMAND_GESTURES:
+				x->x_thread_gestures.g_on = cmd.c_value;
+				sensel_gestures_reset(&x->x_thread_gestures);
+				break;
+			case SENSEL_COMMAND_DEADBAND:
+				x->x_thread_deadband[cmd.c_value] = cmd.c_float;
+				// contacts already down are output once more
+				for (int i = 0; i < 256; i++)
+					x->x_thread_last[i].d_valid = 0;
+				break;
+		}
+	}
+}
+
+/*
+	Sensel thread side: takes objects on and lets them go
+*/
+static void sensel_reactor_events(void)
+{
+	t_sensel_reactor_event e;
+
+	while (sensel_queue_pop(&sensel_reactor.r_events, &e) == 0)
+	{
+		t_sensel *x = e.e_object;
+
+		if (e.e_type == SENSEL_REACTOR_ATTACH)
+		{
+			x->x_thread_next = sensel_reactor.r_objects;
+			sensel_reactor.r_objects = x;
+			continue;
+		}
+
+		// the object is going away, so let go of the device
+		sensel_thread_close(x);
+		for (t_sensel **s = &sensel_reactor.r_objects; *s != NULL; s = &(*s)->x_thread_next)
+		{
+			if (*s == x)
+			{
+				*s = x->x_thread_next;
+				break;
+			}
+		}
+		atomic_store(&x->x_detached, 1);
+	}
+}
+
+/*
+	Sensel thread side: whether a scanning device is due to be
+	read, because its descriptor polled readable, its next frame
+	is due or the poll time has passed
+*/
+static int sensel_reactor_due(t_sensel_hub *h, unsigned long long now)
+{
+	if (h->h_ready || now >= h->h_next_read)
+		return(1);
+	return(h->h_mode == SENSEL_MODE_EVENT
+		&& h->h_backend->b_get_fd(h->h_handle) < 0
+		&& h->h_backend->b_next_frame_usec(h->h_handle) == 0);
+}
+
+/*
+	Sensel thread side: decides to exit when nothing is queued,
+	returning:
+		1 if the thread is to exit
+		0 if there is more to do
+*/
+static int sensel_reactor_idle(void)
+{
+	int idle;
+
+	pthread_mutex_lock(&sensel_reactor.r_mutex);
+	atomic_store(&sensel_reactor.r_running, 0);
+	// pairs with the fence in sensel_reactor_wake()
+	atomic_thread_fence(memory_order_seq_cst);
+	idle = sensel_queue_empty(&sensel_reactor.r_events);
+	for (t_sensel *x = sensel_reactor.r_objects; x != NULL && idle; x = x->x_thread_next)
+		idle = sensel_queue_empty(&x->x_commands);
+	if (!idle)
+		atomic_store(&sensel_reactor.r_running, 1);
+	pthread_mutex_unlock(&sensel_reactor.r_mutex);
+	return(idle);
+}
+
+/*
+	Sensel thread side: waits until the first device's read is
+	due or a command arrives. Devices in event mode are waited
+	on through their serial port's descriptor, all in one poll(),
+	using their poll time only as a timeout. The watcher wakes
+	the thread up for every new list of devices, too. Windows has neither descriptors nor the wakeup pipe, so the
+	thread waits on r_wake_event there instead.
+*/
+static void sensel_reactor_wait(void)
+{
+	unsigned long long now = sensel_monotonic_usec();
+	long long timeout = SENSEL_REACTOR_IDLE;
+	t_sensel_hub *h;
+#ifndef WIN32
+	struct pollfd pfd[1 + SENSEL_MAX_DEVICES];
+	t_sensel_hub *owner[1 + SENSEL_MAX_DEVICES];
+	int n = 1;
+	char buf[64];
+
+	pfd[0].fd = sensel_reactor.r_wake[0];
+	pfd[0].events = POLLIN;
+	pfd[0].revents = 0;
+#endif
+	for (h = sensel_reactor.r_hubs; h != NULL; h = h->h_next)
+	{
+		if (!h->h_scanning)
+			continue;
+
+		long long usec = (h->h_next_read > now ? (long long)(h->h_next_read - now) : 0);
+
+		// running envelopes wake the thread for their next step
+		if (h->h_led_busy)
+		{
+			long long led = (h->h_led_next > now ? (long long)(h->h_led_next - now) : 0);
+			if (led < usec)
+				usec = led;
+		}
+
+		if (h->h_mode == SENSEL_MODE_EVENT)
+		{
+			int fd = h->h_backend->b_get_fd(h->h_handle);
+#ifndef WIN32
+			if (fd >= 0 && n < 1 + SENSEL_MAX_DEVICES)
+			{
+				pfd[n].fd = fd;
+				pfd[n].events = POLLIN;
+				pfd[n].revents = 0;
+				owner[n++] = h;
+			}
+			else
+#endif
+			if (fd < 0)
+			{
+				// no descriptor to wait on, so sleep until the next frame
+				int next = h->h_backend->b_next_frame_usec(h->h_handle);
+				if (next >= 0 && next < usec)
+					usec = next;
+			}
+		}
+		if (usec < timeout)
+			timeout = usec;
+	}
+#ifndef WIN32
+	if (poll(pfd, n, (int)((timeout + 999) / 1000)) > 0)
+	{
+		// drain the wakeups, the commands themselves are in the queues
+		if (pfd[0].revents & POLLIN)
+			while (read(sensel_reactor.r_wake[0], buf, sizeof(buf)) > 0)
+				;
+		for (int i = 1; i < n; i++)
+			if (pfd[i].revents)
+				owner[i]->h_ready = 1;
+	}
+#else
+	if (sensel_reactor.r_wake_event != NULL)
+		WaitForSingleObject(sensel_reactor.r_wake_event, (DWORD)((timeout + 999) / 1000));
+	else
+		usleep(timeout);
+#endif
+}
+
+/*
+	Sensel thread side: closes an unplugged device for all its
+	subscribers, each of which remembers it to reopen it later
+*/
+static void sensel_hub_lost(t_sensel_hub *h)
+{
+	char serial[64];
+
+	// the last subscriber to go frees the hub
+	strcpy(serial, h->h_serial);
+	for (int refs = h->h_refs; refs > 0; refs--)
+	{
+		t_sensel *x = h->h_subscribers;
+
+		sensel_thread_close(x);
+		strcpy(x->x_thread_lost, serial);
+		sensel_send_reply(x, SENSEL_REPLY_DISCONNECTED, SENSEL_COMMAND_HOTPLUG, 2, serial);
+	}
+}
+
+/*
+	Watcher thread: lists the devices for as long as it is wanted
+*/
+static void *sensel_watcher_thread(void *ptr)
+{
+	SenselDeviceList list;
+
+	(void)ptr;
+#ifdef WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined SCHED_IDLE
+	struct sched_param param = { 0 };
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+	for (;;)
+	{
+		pthread_mutex_lock(&sensel_watcher.w_mutex);
+		if (!sensel_watcher.w_wanted)
+		{
+			sensel_watcher.w_running = 0;
+			pthread_mutex_unlock(&sensel_watcher.w_mutex);
+			break;
+		}
+		pthread_mutex_unlock(&sensel_watcher.w_mutex);
+
+		senselGetDeviceList(&list);
+		pthread_mutex_lock(&sensel_watcher.w_mutex);
+		sensel_watcher.w_devices = list;
+		atomic_fetch_add(&sensel_watcher.w_listed, 1);
+		pthread_mutex_unlock(&sensel_watcher.w_mutex);
+		sensel_reactor_wake(0);
+
+		// sleep in steps, so that it exits soon after it is let go
+		for (int slept = 0; slept < SENSEL_REACTOR_WATCH; slept += SENSEL_REACTOR_WATCH_STEP)
+		{
+			pthread_mutex_lock(&sensel_watcher.w_mutex);
+			int wanted = sensel_watcher.w_wanted;
+			pthread_mutex_unlock(&sensel_watcher.w_mutex);
+			if (!wanted)
+				break;
+			usleep(SENSEL_REACTOR_WATCH_STEP);
+		}
+	}
+	return(0);
+}
+
+/*
+	Sensel thread side: starts the watcher or lets it go
+*/
+static void sensel_watcher_want(int wanted)
+{
+	pthread_mutex_lock(&sensel_watcher.w_mutex);
+	sensel_watcher.w_wanted = wanted;
+	if (wanted && !sensel_watcher.w_running)
+	{
+		// a previous watcher has decided to exit and does no more
+		if (sensel_watcher.w_started)
+			pthread_join(sensel_watcher.w_thread, NULL);
+		sensel_watcher.w_started = (pthread_create(&sensel_watcher.w_thread, NULL,
+			sensel_watcher_thread, NULL) == 0);
+		sensel_watcher.w_running = sensel_watcher.w_started;
+	}
+	pthread_mutex_unlock(&sensel_watcher.w_mutex);
+}
+
+/*
+	Sensel thread side: reopens unplugged devices for the objects
+	watching for them, once the watcher lists them again. Objects
+	waiting for the same device share the one list, and only a
+	list the thread has not looked at yet is looked at.
+	Returns whether anyone is waiting.
+*/
+static int sensel_reactor_watch(void)
+{
+	SenselDeviceList *list = &sensel_reactor.r_devices;
+	t_sensel_command cmd;
+	t_sensel *x;
+	int waiting = 0;
+
+	for (x = sensel_reactor.r_objects; x != NULL && !waiting; x = x->x_thread_next)
+		waiting = (x->x_thread_hotplug && x->x_thread_lost[0] != '\0');
+	if (waiting != sensel_reactor.r_watching)
+	{
+		sensel_reactor.r_watching = waiting;
+		sensel_watcher_want(waiting);
+	}
+	if (!waiting || atomic_load(&sensel_watcher.w_listed) == sensel_reactor.r_listed)
+		return(waiting);
+
+	pthread_mutex_lock(&sensel_watcher.w_mutex);
+	*list = sensel_watcher.w_devices;
+	sensel_reactor.r_listed = atomic_load(&sensel_watcher.w_listed);
+	pthread_mutex_unlock(&sensel_watcher.w_mutex);
+
+	for (x = sensel_reactor.r_objects; x != NULL; x = x->x_thread_next)
+	{
+		int i;
+
+		if (!x->x_thread_hotplug || x->x_thread_lost[0] == '\0')
+			continue;
+		for (i = 0; i < list->num_devices; i++)
+			if (!strcmp((const char *)list->devices[i].serial_num, x->x_thread_lost))
+				break;
+		if (i == list->num_devices)
+			continue;
+
+		// one that fails to open is tried again with the next list
+		cmd.c_type = SENSEL_COMMAND_HOTPLUG;
+		cmd.c_value = 1;
+		cmd.c_value2 = 0;
+		cmd.c_float = 0;
+		cmd.c_pointer = NULL;
+		strcpy(cmd.c_text, x->x_thread_lost);
+		sensel_thread_open(x, &cmd);
+	}
+	return(1);
+}
+
+/*
+	Threaded function that reads from every Sensel without
+	blocking the main audio thread. It owns the devices: all
+	USB I/O happens here, driven by commands from the Pd thread.
+*/
+static void *sensel_reactor_thread(void *ptr)
+{
+	t_sensel_hub *h, *next;
+	int watching;
+
+	(void)ptr;
+
+	for (;;)
+	{
+		sensel_reactor_events();
+		for (t_sensel *x = sensel_reactor.r_objects; x != NULL; x = x->x_thread_next)
+			sensel_thread_commands(x);
+
+		for (h = sensel_reactor.r_hubs; h != NULL; h = next)
+		{
+			next = h->h_next;
+			if (!h->h_scanning)
+				continue;
+
+			// the output rings let the thread keep reading while
+			// the previous frames are still waiting to be output
+			if (sensel_reactor_due(h, sensel_monotonic_usec()))
+			{
+				sensel_poll(h);
+				h->h_ready = 0;
+				h->h_next_read = sensel_monotonic_usec() + h->h_poll_wait;
+			}
+
+			// a replayed recording disconnects once it is over,
+			// and the last subscriber to go closes it
+			if (h->h_backend->b_finished(h->h_handle))
+			{
+				for (int refs = h->h_refs; refs > 0; refs--)
+				{
+					t_sensel *x = h->h_subscribers;
+
+					sensel_thread_close(x);
+					sensel_send_reply(x, SENSEL_REPLY_DISCONNECTED, SENSEL_COMMAND_REPLAY, 1, NULL);
+				}
+				continue;
+			}
+
+			if (h->h_read_errors >= SENSEL_LOST_READS)
+			{
+				sensel_hub_lost(h);
+				continue;
+			}
+
+			sensel_update_leds(h, sensel_monotonic_usec());
+		}
+		watching = sensel_reactor_watch();
+
+		// the last device is closed and none is waited for,
+		// so the thread is no longer needed
+		if (sensel_reactor.r_hubs == NULL && !watching && sensel_reactor_idle())
+			break;
+
+		sensel_reactor_wait();
+	}
+
+	return(0);
+}
+
+/*
+	Copies n words into the named array, resizing the array to
+	n if needed. Warns once about a missing array until it
+	shows up (warned is the array's bit in x_pressure_warned).
+*/
+static void sensel_output_array(t_sensel *x, t_symbol *name, const t_word *words, int n, int warned)
+{
+	t_garray *array;
+	t_word *vec;
+	int size;
+
+	if ((array = (t_garray *)pd_findbyclass(name, garray_class)) == NULL
+		|| !garray_getfloatwords(array, &size, &vec))
+	{
+		if (!(x->x_pressure_warned & warned))
+			error("sensel: %s: no float array named %s.",
+				(warned == 1 ? "pressure" : "image"), name->s_name);
+		x->x_pressure_warned |= warned;
+		return;
+	}
+	x->x_pressure_warned &= ~warned;
+	if (size != n)
+	{
+		garray_resize_long(array, n);
+		if (!garray_getfloatwords(array, &size, &vec) || size != n)
+			return;
+	}
+	memcpy(vec, words, n * sizeof(t_word));
+	garray_redraw(array);
+}
+
+/*
+	Copies the front force image and its row and column sums
+	into their arrays
+*/
+static void sensel_output_pressure(t_sensel *x)
+{
+	t_sensel_image *img = &x->x_image;
+	int front = img->i_back ^ 1;
+	int cells = img->i_rows[front] * img->i_cols[front];
+
+	if (x->x_pressure != NULL && cells > 0)
+		sensel_output_array(x, x->x_pressure, img->i_data[front], cells, 1);
+	if (x->x_pressure_rows != NULL && img->i_row_sums[front] > 0)
+		sensel_output_array(x, x->x_pressure_rows, img->i_sums[front], img->i_row_sums[front], 2);
+	if (x->x_pressure_cols != NULL && img->i_col_sums[front] > 0)
+	{
+		sensel_output_array(x, x->x_pressure_cols, img->i_sums[front] + img->i_row_sums[front],
+			img->i_col_sums[front], 4);
+	}
+}
+
+/*
+	Pd thread side: msec until a frame taken at host time usec
+	is due. Pd's logical time runs ahead of the wall clock in
+	bursts, so the offset between the two is smoothed and only
+	follows a large jump (Pd stalled, or its audio restarted)
+	at once.
+*/
+#define SENSEL_LOGICAL_SMOOTH		0.02
+#define SENSEL_LOGICAL_RESYNC		100.0	// msec
+
+static double sensel_output_delay(t_sensel *x, unsigned long long usec)
+{
+	double logical = clock_gettimesince(0);
+	double offset = logical - (double)sensel_monotonic_usec() / 1000.0;
+
+	if (!x->x_logical_valid || fabs(offset - x->x_logical) > SENSEL_LOGICAL_RESYNC)
+	{
+		x->x_logical = offset;
+		x->x_logical_valid = 1;
+	}
+	else
+		x->x_logical += (offset - x->x_logical) * SENSEL_LOGICAL_SMOOTH;
+	return((double)usec / 1000.0 + x->x_latency + x->x_logical - logical);
+}
+
+/*
+	Outputs received data via clock delay that is triggered
+	from the sub-thread. With a latency set, every frame waits
+	until its timestamp plus the latency comes around.
+*/
+static void sensel_output_data(t_sensel *x)
+{
+	// clear the flag before draining, so that a frame committed
+	// while we are draining schedules another output
+	atomic_store(&x->x_clock_set, 0);
+
+	if (x->x_ring.r_slots == NULL)
+		return;
+
+	t_sensel_slot *args;
+	int type, argc;
+	unsigned long long now = sensel_monotonic_usec();
+	// only what is there now, a thread publishing faster than
+	// Pd can output would otherwise keep us here for good
+	unsigned int end = sensel_ring_published(&x->x_ring);
+
+	while ((args = sensel_ring_peek(&x->x_ring, end, &type, &argc)) != NULL)
+	{
+		if (type == SENSEL_RECORD_TIME)
+		{
+			unsigned long long usec = ((unsigned long long)args[0].s_header << 32) | args[1].s_header;
+			unsigned long long read = ((unsigned long long)args[2].s_header << 32) | args[3].s_header;
+			double delay = (x->x_latency > 0 ? sensel_output_delay(x, usec) : 0);
+
+			if (delay > 0)
+			{
+				// the thread need not wake us before then, and
+				// x_clock_output stays the thread's to schedule
+				atomic_store(&x->x_clock_set, 1);
+				clock_delay(x->x_clock_latency, delay);
+				break;
+			}
+			sensel_histogram_add(&x->x_stats_latency, now - read);
+			sensel_ring_pop(&x->x_ring, argc);
+			continue;
+		}
+		// the whole record is released, however much of it fits
+		int length = argc;
+		if (argc > x->x_out_size)
+			argc = x->x_out_size;
+		for (int i = 0; i < argc; i++)
+			SETFLOAT(&x->x_out_args[i], args[i].s_float);
+		sensel_ring_pop(&x->x_ring, length);
+
+		switch (type)
+		{
+			case SENSEL_RECORD_CONTACT:
+				outlet_list(x->x_outlet_data, gensym("list"), argc, x->x_out_args);
+				break;
+			case SENSEL_RECORD_CONTACTS:
+				outlet_anything(x->x_outlet_data, gensym("contacts"), argc, x->x_out_args);
+				break;
+			case SENSEL_RECORD_FRAME:
+				outlet_anything(x->x_outlet_data, gensym("frame"), argc, x->x_out_args);
+				break;
+			case SENSEL_RECORD_BLOB:
+				outlet_anything(x->x_outlet_data, gensym("blob"), argc, x->x_out_args);
+				break;
+			case SENSEL_RECORD_ACCEL:
+				outlet_list(x->x_outlet_accel, gensym("list"), argc, x->x_out_args);
+				break;
+			case SENSEL_RECORD_GESTURE:
+			{
+				// the record is popped already, so only its copy is read
+				if (argc < 1)
+					break;
+				int gesture = (int)atom_getfloat(&x->x_out_args[0]);
+				if (gesture < 0 || gesture >= SENSEL_GESTURES)
+					break;
+				if (gesture == SENSEL_GESTURE_SWIPE && argc > 1)
+				{
+					int direction = (int)atom_getfloat(&x->x_out_args[1]);
+					if (direction < SENSEL_SWIPE_LEFT || direction > SENSEL_SWIPE_DOWN)
+						break;
+					SETSYMBOL(&x->x_out_args[1], gensym(sensel_swipe_names[direction]));
+				}
+				outlet_anything(x->x_outlet_gesture, gensym(sensel_gesture_names[gesture]),
+					argc - 1, x->x_out_args + 1);
+				break;
+			}
+		}
+	}
+
+	// report frames dropped because the ring was full
+	unsigned int overflow = atomic_load(&x->x_ring.r_overflow);
+	if (overflow != x->x_overflow_reported)
+	{
+		t_atom a;
+		x->x_overflow_reported = overflow;
+		SETFLOAT(&a, overflow);
+		outlet_anything(x->x_outlet_status, gensym("overflow"), 1, &a);
+	}
+
+	if (atomic_load_explicit(&x->x_image.i_full, memory_order_acquire))
+	{
+		sensel_output_pressure(x);
+		atomic_store_explicit(&x->x_image.i_full, 0, memory_order_release);
+	}
+}
+
+/*
+	Pd thread side: the device is open, so size the output ring
+	to the sensor's maximum number of contacts and let the
+	thread start scanning. The thread is not writing to the ring
+	at this point, so it is safe to replace it.
+*/
+static void sensel_connected(t_sensel *x, t_sensel_reply *reply)
+{
+	// every frame holds one record per contact (its fields and
+	// zone id, its gestures and its blob) plus the contact count,
+	// with room to spare for the accelerometer
+	sensel_output_data(x);
+	sensel_ring_free(&x->x_ring);
+	sensel_ring_alloc(&x->x_ring, SENSEL_RING_FRAMES * ((reply->r_value + 1)
+		* (SENSEL_FIELDS + 2 + SENSEL_GESTURE_SLOTS + SENSEL_BLOB_FIELDS + 2)));
+	x->x_overflow_reported = 0;
+	sensel_image_free(&x->x_image);
+	sensel_image_alloc(&x->x_image, reply->r_value2, reply->r_value3);
+	// a frame message holds every field and the zone id of every
+	// contact at most
+	freebytes(x->x_out_args, x->x_out_size * sizeof(t_atom));
+	x->x_out_size = 1 + reply->r_value * (SENSEL_FIELDS + 1);
+	x->x_out_args = (t_atom *)getbytes(x->x_out_size * sizeof(t_atom));
+
+	sensel_send_command(x, SENSEL_COMMAND_START, 0, 0, NULL);
+
+	// Post information to the Pd console
+	if (reply->r_command == SENSEL_COMMAND_HOTPLUG)
+		post("sensel: reconnected to device with a serial number %s.", reply->r_text);
+	else
+		post("sensel: successfully connected to device with a serial number %s.", reply->r_text);
+
+	x->x_serial = gensym(reply->r_text);
+	x->x_connecting = 0;
+	x->x_connected = 1;
+
+	outlet_float(x->x_outlet_status, x->x_connected);
+}
+
+/*
+	Pd thread side: reports a failed connect or discover, and
+	that the object is still disconnected on the status outlet.
+	A device being reopened by the watcher is just tried again.
+*/
+static void sensel_connect_failed(t_sensel *x, t_sensel_reply *reply)
+{
+	if (reply->r_command == SENSEL_COMMAND_HOTPLUG)
+		return;
+
+	const char *what = (reply->r_command == SENSEL_COMMAND_CONNECT ? "connect" :
+		(reply->r_command == SENSEL_COMMAND_REPLAY ? "replay" : "discover"));
+
+	x->x_connecting = 0;
+	switch (reply->r_value)
+	{
+		case SENSEL_ERROR_NO_DEVICE:
+			error("sensel: %s failed--no device found.", what);
+			break;
+		case SENSEL_ERROR_NOT_FOUND:
+			error("sensel: %s failed--device with a serial number %s not found.", what, reply->r_text);
+			break;
+		case SENSEL_ERROR_IN_USE:
+			error("sensel: %s failed--device is already connected to another sensel object.", what);
+			break;
+		case SENSEL_ERROR_ALL_IN_USE:
+			error("sensel: %s failed--all discoverable devices are already connected to another sensel object.", what);
+			break;
+		case SENSEL_ERROR_BAD_FILE:
+			error("sensel: %s failed--%s is not a readable sensel recording.", what, reply->r_text);
+			break;
+	}
+	outlet_float(x->x_outlet_status, x->x_connected);
+}
+
+/*
+	Processes replies from the Sensel thread via clock delay
+	that is triggered from the sub-thread
+*/
+static void sensel_process_replies(t_sensel *x)
+{
+	t_sensel_reply reply;
+
+	// clear the flag first, same as in sensel_output_data
+	atomic_store(&x->x_reply_set, 0);
+
+	while (!sensel_queue_pop(&x->x_replies, &reply))
+	{
+		switch (reply.r_type)
+		{
+			case SENSEL_REPLY_CONNECTED:
+				sensel_connected(x, &reply);
+				break;
+			case SENSEL_REPLY_ERROR:
+				sensel_connect_failed(x, &reply);
+				break;
+			case SENSEL_REPLY_DISCONNECTED:
+				// the thread is done with the ring, so
+				// flush whatever it read before it stopped
+				clock_unset(x->x_clock_output);
+				clock_unset(x->x_clock_latency);
+				sensel_output_data(x);
+				x->x_connected = 0;
+				x->x_serial = NULL;
+				if (reply.r_value == 1)
+					post("sensel: replay finished.");
+				else if (reply.r_value == 2)
+					error("sensel: device with a serial number %s was unplugged.", reply.r_text);
+				outlet_float(x->x_outlet_status, x->x_connected);
+				break;
+			case SENSEL_REPLY_RECORDED:
+				x->x_recording = 0;
+				if (reply.r_value3)
+					error("sensel: recording stopped after %d frames--writing the file failed, "
+						"it is cut short and has no index.", reply.r_value);
+				else
+					post("sensel: recording stopped after %d frames (%d dropped).",
+						reply.r_value, reply.r_value2);
+				break;
+			case SENSEL_REPLY_IDENTIFY:
+				if (reply.r_value == 0)
+					post("sensel: identify found no devices.");
+				else
+					post("sensel: identify found following devices:");
+				break;
+			case SENSEL_REPLY_DEVICE:
+				post("%d: %s", reply.r_value, reply.r_text);
+				break;
+		}
+	}
+}
+
+/*
+	Connects the Pd patch to a specific Sensel device, using
+	the serial number as an argument.
+*/
+static void sensel_connect(t_sensel *x, t_symbol *s)
+{
+	post("sensel: connecting to device with serial number %s...", s->s_name);
+
+	if (x->x_connected == 1 || x->x_connecting == 1)
+	{
+		error("sensel: connect failed--device already connected.");
+		return;
+	}
+
+	if (!sensel_send_command(x, SENSEL_COMMAND_CONNECT, 0, 0, s->s_name))
+		x->x_connecting = 1;
+}
+
+/*
+	Discovers and connects to the first available Sensel Morph
+*/
+static void sensel_discover(t_sensel *x)
+{
+	if (x->x_connected == 1 || x->x_connecting == 1)
+	{
+		error("sensel: discover failed--device already connected.");
+		return;
+	}
+
+	if (!sensel_send_command(x, SENSEL_COMMAND_DISCOVER, 0, 0, NULL))
+		x->x_connecting = 1;
+}
+
+/*
+	Lists serial numbers of all available Sensel Morphs. The
+	thread does this in between reads, so it no longer clashes
+	with data output as it used to on Macs.
+*/
+static void sensel_identify(t_sensel *x)
+{
+	sensel_send_command(x, SENSEL_COMMAND_IDENTIFY, 0, 0, NULL);
+}
+
+/*
+	Starts recording every frame read from the connected device
+	to a file (relative to the patch's directory)
+*/
+static void sensel_record(t_sensel *x, t_symbol *s)
+{
+	char path[MAXPDSTRING];
+	FILE *file;
+
+	if (x->x_connected != 1)
+	{
+		error("sensel: record failed--no device connected.");
+		return;
+	}
+	if (x->x_recording)
+	{
+		error("sensel: record failed--already recording.");
+		return;
+	}
+
+	canvas_makefilename(x->x_canvas, s->s_name, path, MAXPDSTRING);
+	if ((file = fopen(path, "wb")) == NULL)
+	{
+		error("sensel: record failed--could not open %s for writing.", path);
+		return;
+	}
+
+	t_sensel_recorder *r = sensel_recorder_new(file);
+	if (sensel_send_command_pointer(x, SENSEL_COMMAND_RECORD, r, 0) < 0)
+	{
+		sensel_recorder_detach(r);
+		return;
+	}
+	x->x_recording = 1;
+	post("sensel: recording to %s...", path);
+}
+
+/*
+	Stops recording or, if there is no recording, a replay
+*/
+static void sensel_stop(t_sensel *x)
+{
+	if (x->x_recording)
+		sensel_send_command(x, SENSEL_COMMAND_STOP, 0, 0, NULL);
+	else if (x->x_connected && x->x_serial != NULL
+		&& !strncmp(x->x_serial->s_name, SENSEL_REPLAY_PREFIX, strlen(SENSEL_REPLAY_PREFIX)))
+	{
+		sensel_send_command(x, SENSEL_COMMAND_DISCONNECT, 0, 0, NULL);
+	}
+	else
+		error("sensel: stop failed--not recording or replaying.");
+}
+
+/*
+	Replays a recording in place of a device: "replay <file>
+	[speed]", where speed scales the recorded rate (default 1,
+	0 replays as fast as possible)
+*/
+static void sensel_replay(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	char path[MAXPDSTRING];
+	float speed = 1;
+	(void)s;
+
+	if (argc < 1 || argv[0].a_type != A_SYMBOL)
+	{
+		error("sensel: replay needs a file name.");
+		return;
+	}
+	if (argc > 1)
+		speed = atom_getfloat(&argv[1]);
+	if (x->x_connected == 1 || x->x_connecting == 1)
+	{
+		error("sensel: replay failed--device already connected.");
+		return;
+	}
+
+	canvas_makefilename(x->x_canvas, atom_getsymbol(&argv[0])->s_name, path, MAXPDSTRING);
+	char *copy = (char *)getbytes(strlen(path) + 1);
+	strcpy(copy, path);
+	if (sensel_send_command_pointer(x, SENSEL_COMMAND_REPLAY, copy, speed) < 0)
+	{
+		freebytes(copy, strlen(copy) + 1);
+		return;
+	}
+	x->x_connecting = 1;
+	post("sensel: replaying %s...", path);
+}
+
+/*
+	Jumps to a point of the running replay, in msec from the
+	start of the recording
+*/
+static void sensel_seek(t_sensel *x, t_floatarg f)
+{
+	if (x->x_connected != 1 || x->x_serial == NULL
+		|| strncmp(x->x_serial->s_name, SENSEL_REPLAY_PREFIX, strlen(SENSEL_REPLAY_PREFIX)))
+	{
+		error("sensel: seek failed--not replaying.");
+		return;
+	}
+	sensel_send_command(x, SENSEL_COMMAND_SEEK, (int)f, 0, NULL);
+}
+
+/*
+	Outputs the force image into an array: "pressure <array>
+	[factor]", where the optional factor averages factor x
+	factor blocks of cells into one. A bare "pressure" turns
+	the image off again.
+*/
+static void sensel_pressure(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	int factor = 1;
+	(void)s;
+
+	if (argc < 1)
+	{
+		x->x_pressure = NULL;
+		sensel_send_command(x, SENSEL_COMMAND_PRESSURE, 0, 0, NULL);
+		return;
+	}
+	if (argv[0].a_type != A_SYMBOL)
+	{
+		error("sensel: pressure needs an array name.");
+		return;
+	}
+	if (argc > 1)
+		factor = (int)atom_getfloat(&argv[1]);
+	if (factor < 1 || factor > SENSEL_PRESSURE_MAX_FACTOR)
+	{
+		error("sensel: pressure downsampling factor has to be between 1 and %d.",
+			SENSEL_PRESSURE_MAX_FACTOR);
+		return;
+	}
+	x->x_pressure = atom_getsymbol(&argv[0]);
+	x->x_pressure_warned &= ~1;
+	sensel_send_command(x, SENSEL_COMMAND_PRESSURE, factor, 0, NULL);
+}
+
+/*
+	Configures the force image processing done on the Sensel
+	thread: "image <stage> <value>", with gain, threshold,
+	blur (sigma in cells) and smooth (0-1) stages, "image rows
+	<array>" and "image cols <array>" for the row and column
+	sums (without an array to turn them off) and "image reset"
+*/
+static void sensel_image(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	t_symbol *stage = atom_getsymbolarg(0, argc, argv);
+	t_float value = atom_getfloatarg(1, argc, argv);
+	(void)s;
+
+	if (stage == gensym("rows") || stage == gensym("cols"))
+	{
+		int rows = (stage == gensym("rows"));
+		t_symbol *array = (argc > 1 && argv[1].a_type == A_SYMBOL ? argv[1].a_w.w_symbol : NULL);
+
+		if (rows)
+			x->x_pressure_rows = array;
+		else
+			x->x_pressure_cols = array;
+		x->x_pressure_warned &= ~(rows ? 2 : 4);
+		sensel_send_command_float(x, SENSEL_COMMAND_IMAGE,
+			(rows ? SENSEL_IMAGE_ROWS : SENSEL_IMAGE_COLS), (array != NULL));
+	}
+	else if (stage == gensym("reset"))
+	{
+		x->x_pressure_rows = NULL;
+		x->x_pressure_cols = NULL;
+		sensel_send_command_float(x, SENSEL_COMMAND_IMAGE, SENSEL_IMAGE_RESET, 0);
+	}
+	else if (argc < 2 || argv[1].a_type != A_FLOAT)
+		error("sensel: image needs a stage and a value.");
+	else if (stage == gensym("gain"))
+		sensel_send_command_float(x, SENSEL_COMMAND_IMAGE, SENSEL_IMAGE_GAIN, value);
+	else if (stage == gensym("threshold"))
+		sensel_send_command_float(x, SENSEL_COMMAND_IMAGE, SENSEL_IMAGE_THRESHOLD, value);
+	else if (stage == gensym("blur"))
+	{
+		if (value < 0 || value > SENSEL_BLUR_MAX_SIGMA)
+			error("sensel: image blur has to be between 0 and %g cells.", SENSEL_BLUR_MAX_SIGMA);
+		else
+			sensel_send_command_float(x, SENSEL_COMMAND_IMAGE, SENSEL_IMAGE_BLUR, value);
+	}
+	else if (stage == gensym("smooth"))
+	{
+		if (value < 0 || value >= 1)
+			error("sensel: image smooth has to be at least 0 and less than 1.");
+		else
+			sensel_send_command_float(x, SENSEL_COMMAND_IMAGE, SENSEL_IMAGE_SMOOTH, value);
+	}
+	else
+		error("sensel: unknown image stage %s.", stage->s_name);
+}
+
+/*
+	Sensel thread side: fills the 20 fields of a contact list
+*/
+static void sensel_contact_fields(const SenselContact *contact, float *fields)
+{
+	fields[0] = contact->id;
+	fields[1] = contact->state;
+	fields[2] = contact->orientation;
+	fields[3] = contact->major_axis;
+	fields[4] = contact->minor_axis;
+	fields[5] = contact->delta_x;
+	fields[6] = contact->delta_y;
+	fields[7] = contact->delta_force;
+	fields[8] = contact->delta_area;
+	fields[9] = contact->min_x;
+	fields[10] = contact->min_y;
+	fields[11] = contact->max_x;
+	fields[12] = contact->max_y;
+	fields[13] = contact->peak_x;
+	fields[14] = contact->peak_y;
+	fields[16] = contact->x_pos;
+	fields[17] = contact->y_pos;
+	fields[19] = contact->area;
+
+	if (contact->state != CONTACT_END)
+	{
+		fields[15] = contact->peak_force;
+		fields[18] = contact->total_force;
+	}
+	else
+	{
+		fields[15] = 0;
+		fields[18] = 0;
+	}
+}
+
+/*
+	Parses a list of field names into a field mask, returning:
+		0 for success
+		-1 if a name is unknown (and reported)
+*/
+static int sensel_parse_fields(int argc, t_atom *argv, int *mask)
+{
+	*mask = 0;
+	for (int i = 0; i < argc; i++)
+	{
+		t_symbol *name = atom_getsymbol(&argv[i]);
+		int f;
+
+		for (f = 0; f < SENSEL_FIELDS; f++)
+			if (!strcmp(name->s_name, sensel_field_names[f]))
+				break;
+		if (f == SENSEL_FIELDS)
+		{
+			error("sensel: unknown contact field %s.", name->s_name);
+			return(-1);
+		}
+		*mask |= (1 << f);
+	}
+	return(0);
+}
+
+/*
+	Selects the contact fields the patch needs: "fields <field
+	...>" or "fields all". Only these are output, in contact
+	list order, and the device is told to skip optional groups
+	(ellipse, deltas, bounding box, peak) none of them is in.
+*/
+static int sensel_select_fields(t_sensel *x, int argc, t_atom *argv)
+{
+	int mask = SENSEL_FIELDS_ALL;
+
+	if (argc > 0 && atom_getsymbol(&argv[0]) != gensym("all")
+		&& sensel_parse_fields(argc, argv, &mask) < 0)
+	{
+		return(-1);
+	}
+	return(sensel_send_command(x, SENSEL_COMMAND_FIELDS, mask, 0, NULL));
+}
+
+static void sensel_fields(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	(void)s;
+	sensel_select_fields(x, argc, argv);
+}
+
+/*
+	Selects the output format: "format contacts" for a list per
+	contact, "format frame" for one message per frame; fields
+	given after the format are selected as with "fields"
+*/
+static void sensel_format(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	t_symbol *format = atom_getsymbolarg(0, argc, argv);
+
+	if (format != gensym("contacts") && format != gensym("frame"))
+	{
+		error("sensel: format has to be contacts or frame.");
+		return;
+	}
+	(void)s;
+
+	if (argc > 1 && sensel_select_fields(x, argc - 1, argv + 1) < 0)
+		return;
+	sensel_send_command(x, SENSEL_COMMAND_FORMAT,
+		(format == gensym("frame") ? SENSEL_FORMAT_FRAME : SENSEL_FORMAT_CONTACTS), 0, NULL);
+}
+
+/*
+	Edits the zone table: "zone <id> <left> <top> <right> <bottom>"
+	sets a rectangle, "zone <id> <x> <y> <x> <y> <x> <y> ..." a
+	polygon of 3 to 16 points, "zone <id>" removes a zone and
+	"zone clear" all of them (positions in mm). While there are
+	zones, only contacts that start in one are output, tagged
+	with its id.
+*/
+static void sensel_zone(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	t_sensel_zones *copy = NULL;
+	t_sensel_zone zone;
+	int i;
+
+	(void)s;
+	if (argc == 1 && argv[0].a_type == A_SYMBOL && atom_getsymbol(&argv[0]) == gensym("clear"))
+	{
+		if (x->x_zones != NULL)
+			x->x_zones->z_count = 0;
+	}
+	else if (argc < 1 || argv[0].a_type != A_FLOAT)
+	{
+		error("sensel: zone needs an id, or clear.");
+		return;
+	}
+	else
+	{
+		int points = (argc - 1) / 2;
+
+		if ((argc - 1) % 2 || points == 1 || points > SENSEL_ZONE_VERTICES)
+		{
+			error("sensel: zone needs a rectangle (left top right bottom) or 3 to %d points.",
+				SENSEL_ZONE_VERTICES);
+			return;
+		}
+		if (x->x_zones == NULL)
+		{
+			x->x_zones = (t_sensel_zones *)getbytes(sizeof(t_sensel_zones));
+			x->x_zones->z_count = 0;
+		}
+		zone.z_id = (int)atom_getfloat(&argv[0]);
+		if (points == 0)
+			sensel_zones_remove(x->x_zones, zone.z_id);
+		else
+		{
+			if (points == 2)
+			{
+				zone.z_vertices = 0;
+				zone.z_left = fminf(atom_getfloat(&argv[1]), atom_getfloat(&argv[3]));
+				zone.z_right = fmaxf(atom_getfloat(&argv[1]), atom_getfloat(&argv[3]));
+				zone.z_top = fminf(atom_getfloat(&argv[2]), atom_getfloat(&argv[4]));
+				zone.z_bottom = fmaxf(atom_getfloat(&argv[2]), atom_getfloat(&argv[4]));
+			}
+			else
+			{
+				zone.z_vertices = points;
+				for (i = 0; i < points; i++)
+				{
+					zone.z_x[i] = atom_getfloat(&argv[1 + 2 * i]);
+					zone.z_y[i] = atom_getfloat(&argv[2 + 2 * i]);
+				}
+				zone.z_left = zone.z_right = zone.z_x[0];
+				zone.z_top = zone.z_bottom = zone.z_y[0];
+				for (i = 1; i < points; i++)
+				{
+					zone.z_left = fminf(zone.z_left, zone.z_x[i]);
+					zone.z_right = fmaxf(zone.z_right, zone.z_x[i]);
+					zone.z_top = fminf(zone.z_top, zone.z_y[i]);
+					zone.z_bottom = fmaxf(zone.z_bottom, zone.z_y[i]);
+				}
+			}
+			if (sensel_zones_set(x->x_zones, &zone) < 0)
+			{
+				error("sensel: zone failed--at most %d zones.", SENSEL_ZONES);
+				return;
+			}
+		}
+	}
+
+	// the thread gets a copy of its own, or none without zones
+	if (x->x_zones != NULL && x->x_zones->z_count > 0)
+	{
+		copy = (t_sensel_zones *)getbytes(sizeof(t_sensel_zones));
+		memcpy(copy, x->x_zones, sizeof(t_sensel_zones));
+		copy->z_cell_width = 0;
+		copy->z_cell_height = 0;
+	}
+	if (sensel_send_command_pointer(x, SENSEL_COMMAND_ZONES, copy, 0) < 0 && copy != NULL)
+		freebytes(copy, sizeof(t_sensel_zones));
+}
+
+/*
+	Sets a deadband: "deadband position <mm>", "deadband force
+	<grams>" or "deadband area <value>", 0 to leave the quantity
+	out, and "deadband off" for none (the default). Moving
+	contacts are only output once one of the quantities with a
+	band has changed by at least that much.
+*/
+static void sensel_deadband(t_sensel *x, t_symbol *s, t_floatarg f)
+{
+	int which;
+
+	if (s == gensym("off"))
+	{
+		for (which = 0; which < SENSEL_DEADBANDS; which++)
+			sensel_send_command_float(x, SENSEL_COMMAND_DEADBAND, which, 0);
+		return;
+	}
+	if (s == gensym("position"))
+		which = SENSEL_DEADBAND_POSITION;
+	else if (s == gensym("force"))
+		which = SENSEL_DEADBAND_FORCE;
+	else if (s == gensym("area"))
+		which = SENSEL_DEADBAND_AREA;
+	else
+	{
+		error("sensel: deadband must be position, force, area or off.");
+		return;
+	}
+	if (f < 0)
+	{
+		error("sensel: deadband must not be negative.");
+		return;
+	}
+	sensel_send_command_float(x, SENSEL_COMMAND_DEADBAND, which, f);
+}
+
+/*
+	Selects the contact filter for x, y and force: "filter exp
+	<smooth>" (0 for none, up to but not including 1), "filter
+	euro <mincutoff> [beta] [dcutoff]" or "filter off"
+*/
+static void sensel_filter(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	t_symbol *type = atom_getsymbolarg(0, argc, argv);
+	(void)s;
+
+	if (type == gensym("off"))
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_TYPE, SENSEL_FILTER_OFF);
+	else if (type == gensym("exp"))
+	{
+		t_float smooth = atom_getfloatarg(1, argc, argv);
+
+		if (argc < 2 || smooth < 0 || smooth >= 1)
+		{
+			error("sensel: filter exp has to be at least 0 and less than 1.");
+			return;
+		}
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_SMOOTH, smooth);
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_TYPE, SENSEL_FILTER_EXP);
+	}
+	else if (type == gensym("euro"))
+	{
+		t_float mincutoff = atom_getfloatarg(1, argc, argv);
+		t_float beta = atom_getfloatarg(2, argc, argv);
+		t_float dcutoff = (argc > 3 ? atom_getfloatarg(3, argc, argv) : 1);
+
+		if (mincutoff <= 0 || beta < 0 || dcutoff <= 0)
+		{
+			error("sensel: filter euro needs cutoffs above 0 Hz and a beta of at least 0.");
+			return;
+		}
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_MINCUTOFF, mincutoff);
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_BETA, beta);
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_DCUTOFF, dcutoff);
+		sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_TYPE, SENSEL_FILTER_EURO);
+	}
+	else
+		error("sensel: filter must be exp, euro or off.");
+}
+
+/*
+	Extrapolates x and y by a look-ahead in msec, 0 to stop
+*/
+static void sensel_predict(t_sensel *x, t_floatarg f)
+{
+	if (f < 0 || f > SENSEL_PREDICT_MAX)
+	{
+		error("sensel: predict has to be between 0 and %d ms.", SENSEL_PREDICT_MAX);
+		return;
+	}
+	sensel_send_command_float(x, SENSEL_COMMAND_FILTER, SENSEL_FILTER_PREDICT, f);
+}
+
+/*
+	Outputs the accelerometer (right outlet) averaged over a
+	number of frames, only once it changed by at least the
+	threshold on any axis: "accel <frames> [threshold]", "accel
+	0" (the default) turns it off
+*/
+static void sensel_accel(t_sensel *x, t_floatarg frames, t_floatarg threshold)
+{
+	if (frames < 0 || frames > SENSEL_ACCEL_MAX_FRAMES || threshold < 0)
+	{
+		error("sensel: accel averages 0 to %d frames, with a threshold of at least 0.",
+			SENSEL_ACCEL_MAX_FRAMES);
+		return;
+	}
+	sensel_send_command_float(x, SENSEL_COMMAND_ACCEL, (int)frames, threshold);
+}
+
+/*
+	Turns reopening unplugged devices on or off (the default)
+*/
+static void sensel_hotplug(t_sensel *x, t_symbol *s)
+{
+	if (s == gensym("on"))
+		sensel_send_command(x, SENSEL_COMMAND_HOTPLUG, 1, 0, NULL);
+	else if (s == gensym("off"))
+		sensel_send_command(x, SENSEL_COMMAND_HOTPLUG, 0, 0, NULL);
+	else
+		error("sensel: hotplug must be on or off.");
+}
+
+/*
+	Turns the blob statistics on or off (the default)
+*/
+static void sensel_blobs(t_sensel *x, t_symbol *s)
+{
+	if (s == gensym("on"))
+		sensel_send_command(x, SENSEL_COMMAND_BLOBS, 1, 0, NULL);
+	else if (s == gensym("off"))
+		sensel_send_command(x, SENSEL_COMMAND_BLOBS, 0, 0, NULL);
+	else
+		error("sensel: blobs must be on or off.");
+}
+
+/*
+	Turns the gestures (third outlet) on or off (the default)
+*/
+static void sensel_gestures(t_sensel *x, t_symbol *s)
+{
+	if (s == gensym("on"))
+		sensel_send_command(x, SENSEL_COMMAND_GESTURES, 1, 0, NULL);
+	else if (s == gensym("off"))
+		sensel_send_command(x, SENSEL_COMMAND_GESTURES, 0, 0, NULL);
+	else
+		error("sensel: gestures must be on or off.");
+}
+
+/*
+	Sets the fixed latency in msec from the time the device took
+	a frame to the frame's output, evening out the delays of
+	reading and scheduling. 0 (the default) outputs every frame
+	as soon as it is read.
+*/
+#define SENSEL_LATENCY_MAX			100
+
+static void sensel_latency(t_sensel *x, t_floatarg f)
+{
+	if (f < 0 || f > SENSEL_LATENCY_MAX)
+	{
+		error("sensel: latency must be between 0 and %d ms.", SENSEL_LATENCY_MAX);
+		return;
+	}
+	x->x_latency = f;
+	// frames held back for the old latency
+	clock_delay(x->x_clock_latency, 0);
+}
+
+/*
+	Outputs one "stats <name> <p50> <p99> <max>" line for a
+	histogram, in msec
+*/
+static void sensel_stats_histogram(t_sensel *x, const char *name, t_sensel_histogram *h)
+{
+	unsigned int p50, p99, max;
+	t_atom a[4];
+
+	sensel_histogram_summary(h, &p50, &p99, &max);
+	SETSYMBOL(&a[0], gensym(name));
+	SETFLOAT(&a[1], p50 / 1000.0f);
+	SETFLOAT(&a[2], p99 / 1000.0f);
+	SETFLOAT(&a[3], max / 1000.0f);
+	outlet_anything(x->x_outlet_status, gensym("stats"), 4, a);
+}
+
+/*
+	Reports how the object is doing on the status outlet, one
+	"stats" message per measure: frames (read in total and per
+	second since the last report), contacts (per frame on
+	average and at most), lost (frames the device dropped),
+	ring (most output slots in use and the ring size), and the
+	p50, p99 and longest time in msec of latency (from reading
+	a frame to its output), read (reading the sensor) and lock
+	(holding the connected devices lock, across all objects).
+	"stats reset" starts counting afresh.
+*/
+static void sensel_stats(t_sensel *x, t_symbol *s, int argc, t_atom *argv)
+{
+	t_sensel_stats *stats = &x->x_thread_stats;
+	unsigned long long now = sensel_monotonic_usec();
+	(void)s;
+
+	if (argc > 0 && atom_getsymbol(&argv[0]) == gensym("reset"))
+	{
+		sensel_send_command(x, SENSEL_COMMAND_STATS, 0, 0, NULL);
+		sensel_histogram_reset(&x->x_stats_latency);
+		x->x_stats_frames = 0;
+		x->x_stats_time = now;
+		return;
+	}
+
+	unsigned int frames = atomic_load_explicit(&stats->s_frames, memory_order_relaxed);
+	unsigned int contacts = atomic_load_explicit(&stats->s_contacts, memory_order_relaxed);
+	double elapsed = (double)(now - x->x_stats_time) / 1000000.0;
+	t_atom a[3];
+
+	// a reset the thread has not got to yet looks like a wrap
+	unsigned int fresh = (frames >= x->x_stats_frames ? frames - x->x_stats_frames : frames);
+	SETSYMBOL(&a[0], gensym("frames"));
+	SETFLOAT(&a[1], frames);
+	SETFLOAT(&a[2], (elapsed > 0 ? fresh / elapsed : 0));
+	outlet_anything(x->x_outlet_status, gensym("stats"), 3, a);
+	x->x_stats_frames = frames;
+	x->x_stats_time = now;
+
+	SETSYMBOL(&a[0], gensym("contacts"));
+	SETFLOAT(&a[1], (frames > 0 ? (float)contacts / frames : 0));
+	SETFLOAT(&a[2], atomic_load_explicit(&stats->s_max_contacts, memory_order_relaxed));
+	outlet_anything(x->x_outlet_status, gensym("stats"), 3, a);
+
+	SETSYMBOL(&a[0], gensym("lost"));
+	SETFLOAT(&a[1], atomic_load_explicit(&stats->s_lost, memory_order_relaxed));
+	outlet_anything(x->x_outlet_status, gensym("stats"), 2, a);
+
+	SETSYMBOL(&a[0], gensym("ring"));
+	SETFLOAT(&a[1], atomic_load_explicit(&stats->s_ring_high, memory_order_relaxed));
+	SETFLOAT(&a[2], x->x_ring.r_size);
+	outlet_anything(x->x_outlet_status, gensym("stats"), 3, a);
+
+	sensel_stats_histogram(x, "latency", &x->x_stats_latency);
+	sensel_stats_histogram(x, "read", &stats->s_read);
+	sensel_stats_histogram(x, "lock", &sensel_connected_devices_hold);
+}
+
+/*
+	Sensel thread side: finds the zone of every contact in a frame
+	(index + 1, 0 to leave the contact out), returning the number
+	of contacts to output. A contact stays in the zone it started
+	in until it ends, so the end of a contact that slid out of its
+	zone is never lost. Without zones every contact goes out.
+*/
+static int sensel_poll_zones(t_sensel *x, const SenselFrameData *frame, unsigned char *zones)
+{
+	const t_sensel_zones *z = x->x_thread_zones;
+	int n = 0;
+
+	for (int c = 0; c < frame->n_contacts; c++)
+	{
+		const SenselContact *contact = &frame->contacts[c];
+		unsigned char *zone = &x->x_thread_contact_zone[contact->id];
+
+		if (z == NULL)
+			zones[c] = 1;
+		else
+		{
+			if (*zone == SENSEL_ZONE_UNKNOWN || contact->state == CONTACT_START)
+				*zone = sensel_zones_find(z, contact->x_pos, contact->y_pos);
+			zones[c] = *zone;
+			if (contact->state == CONTACT_END)
+				*zone = SENSEL_ZONE_UNKNOWN;
+		}
+		if (zones[c])
+			n++;
 	}
-	x->x_poll_wait = (int)(f * 1000.0);
+	return(n);
 }
 
 /*
-	Sets Sensel's LED with an ID to a desired brightness in (0-100)
+	Sensel thread side: runs the contact filters over a frame
+	taken at time (usec), returning:
+		1 if the contacts are filtered
+		0 if there are no filters
 */
-static void sensel_set_led(t_sensel *x, t_floatarg id, t_floatarg brightness)
+static int sensel_poll_filter(t_sensel *x, const SenselFrameData *frame, unsigned long long time)
 {
-	if (x->x_connected == 1)
+	const t_sensel_filter *f = &x->x_thread_filter;
+
+	if (f->f_type == SENSEL_FILTER_OFF && f->f_predict <= 0)
+		return(0);
+	for (int c = 0; c < frame->n_contacts; c++)
 	{
-		if (id >= 0 && id <= 23 && brightness >= 0 && brightness <= 100)
-		{
-			x->x_led[(int)id] = (int)brightness;
-		}
+		const SenselContact *contact = &frame->contacts[c];
+		t_sensel_track *track = &x->x_thread_track[contact->id];
+		float in[3] = { contact->x_pos, contact->y_pos, contact->total_force };
+
+		if (contact->state == CONTACT_START)
+			track->t_valid = 0;
+		sensel_track_update(f, track, in, time);
+		if (contact->state == CONTACT_END)
+			track->t_valid = 0;
 	}
+	return(1);
 }
 
 /*
-	Processes changes in LEDs via subthread call
+	Sensel thread side: fills the 20 fields of a contact list,
+	with the filtered x, y and force if filtered
 */
-static void sensel_update_leds(t_sensel *x)
+static void sensel_poll_fields(t_sensel *x, const SenselContact *contact, int filtered, float *fields)
 {
-	for (int i = 0; i < 24; i++)
+	sensel_contact_fields(contact, fields);
+	if (filtered)
 	{
-		if (x->x_led[i] != x->x_thread_led[i])
-		{
-			x->x_thread_led[i] = x->x_led[i];
-			senselSetLEDBrightness(x->x_handle, i, x->x_thread_led[i]);
-		}
+		const float *out = x->x_thread_track[contact->id].t_out;
+
+		fields[16] = out[0];
+		fields[17] = out[1];
+		fields[18] = out[2];
 	}
 }
 
 /*
-	Threaded function that reads from the Sensel
-	without blocking the main audio thread
+	Sensel thread side: picks the contacts (of those in a zone)
+	that changed enough to be output, returning their number.
+	Contacts starting or ending always are, as is every contact
+	without deadbands.
 */
-static void *sensel_pthreadForAudioUnfriendlyOperations(void *ptr)
+static int sensel_poll_deadband(t_sensel *x, const SenselFrameData *frame,
+	const unsigned char *zones, int filtered, unsigned char *changed)
 {
-	t_threadedFunctionParams *rPars = (t_threadedFunctionParams*)ptr;
-	t_sensel *x = rPars->s_inst;
+	const float *band = x->x_thread_deadband;
+	int active = (band[SENSEL_DEADBAND_POSITION] > 0 || band[SENSEL_DEADBAND_FORCE] > 0
+		|| band[SENSEL_DEADBAND_AREA] > 0);
+	int n = 0;
 
-	while(x->x_unsafe > -1)
+	for (int c = 0; c < frame->n_contacts; c++)
 	{
-		pthread_mutex_lock(&x->x_unsafe_mutex);
-		// inform the external when the thread is ready
-		if (x->x_unsafe == 1)
-			x->x_unsafe = 0;
-
-		if (x->x_thread_connected != x->x_connected)
-		{
-			x->x_thread_connected = x->x_connected;
-			if (x->x_thread_connected)
-			{
-				// Start scanning the Sensel device
-				senselStartScanning(x->x_handle);
-			}
-			else {
-				// This is where we stop scanning and disconnect
-				senselStopScanning(x->x_handle);
-				senselFreeFrameData(x->x_handle, x->x_frame);
-				senselClose(x->x_handle);
-			}
-		}
+		const SenselContact *contact = &frame->contacts[c];
+		t_sensel_deadband *last = &x->x_thread_last[contact->id];
 
-		// only poll for new data if the previous sensel_output_data
-		// has been processed (I suppose this could be also done
-		// with a semaphore but since Windows pthreads implementation
-		// via CygWin is not entirely compatible, I figured this may
-		// be a "cleaner" way to do this
-		if (x->x_clock_set == 0)
+		changed[c] = zones[c];
+		if (!zones[c] || !active)
 		{
-			sensel_poll(x);
+			n += changed[c];
+			continue;
 		}
 
-		sensel_update_leds(x);
+		// the bands apply to the values that are output
+		const float *out = x->x_thread_track[contact->id].t_out;
+		float px = (filtered ? out[0] : contact->x_pos);
+		float py = (filtered ? out[1] : contact->y_pos);
+		float force = (filtered ? out[2] : contact->total_force);
 
-		pthread_mutex_unlock(&x->x_unsafe_mutex);
+		if (contact->state == CONTACT_MOVE && last->d_valid)
+		{
+			float dx = px - last->d_x, dy = py - last->d_y;
 
-		usleep(x->x_poll_wait);
+			changed[c] = ((band[SENSEL_DEADBAND_POSITION] > 0 && dx * dx + dy * dy
+					>= band[SENSEL_DEADBAND_POSITION] * band[SENSEL_DEADBAND_POSITION])
+				|| (band[SENSEL_DEADBAND_FORCE] > 0
+					&& fabsf(force - last->d_force) >= band[SENSEL_DEADBAND_FORCE])
+				|| (band[SENSEL_DEADBAND_AREA] > 0
+					&& fabsf(contact->area - last->d_area) >= band[SENSEL_DEADBAND_AREA]));
+		}
+		if (changed[c])
+		{
+			last->d_x = px;
+			last->d_y = py;
+			last->d_force = force;
+			last->d_area = contact->area;
+			last->d_valid = (contact->state != CONTACT_END);
+			n++;
+		}
 	}
-	pthread_exit(0);
-
-	return(0);
+	return(n);
 }
 
 /*
-	Outputs received data via clock delay that is triggered
-	from the sub-thread
+	Sensel thread side: sums up the accelerometer over a number
+	of frames and queues their average if it moved by at least
+	the threshold on any axis since it was last output
 */
-static void sensel_output_data(t_sensel *x)
+static void sensel_poll_accel(t_sensel *x, const SenselFrameData *frame)
 {
-    if (x->x_clock_set == 1)
-    {
-		while (x->x_data != NULL)
-		{
-			switch (x->x_data->type)
-            {
-				case 0: // data
-                    outlet_list(x->x_outlet_data, gensym("list"), 20, x->x_data->args);
-					break;
-				case 1: // number of contacts
-					outlet_anything(x->x_outlet_data, gensym("contacts"), 1, &x->x_data->args[0]);
-					break;
-			}
-			t_data *last = x->x_data;
-            x->x_data = x->x_data->next;
-			free(last);
-		}
-        x->x_clock_set = 0;
-    }
+	const SenselAccelData *accel = frame->accel_data;
+	float *sum = x->x_thread_accel_sum, *last = x->x_thread_accel_last;
+	t_sensel_slot *args;
+	int i;
+
+	if (x->x_thread_accel_count == 0)
+		sum[0] = sum[1] = sum[2] = 0;
+	sum[0] += accel->x;
+	sum[1] += accel->y;
+	sum[2] += accel->z;
+	if (++x->x_thread_accel_count < x->x_thread_accel_frames)
+		return;
+	for (i = 0; i < 3; i++)
+		sum[i] /= x->x_thread_accel_count;
+	x->x_thread_accel_count = 0;
+
+	for (i = 0; i < 3 && x->x_thread_accel_valid; i++)
+		if (fabsf(sum[i] - last[i]) >= x->x_thread_accel_threshold)
+			break;
+	if (i == 3)
+		return;
+	if ((args = sensel_ring_push(&x->x_ring, SENSEL_RECORD_ACCEL, 3)) != NULL)
+	{
+		for (i = 0; i < 3; i++)
+			args[i].s_float = last[i] = sum[i];
+		x->x_thread_accel_valid = 1;
+	}
 }
 
 /*
-	Connects the Pd patch to a specific Sensel device, using
-	the serial number as an argument.
+	Sensel thread side: gathers the blob statistics of a frame
+	in a single pass over the images, then queues a record for
+	every contact (of those in a zone) with a blob. A cell's
+	neighbours in the rows above and below are read alongside
+	it, so the scan only ever touches three rows at a time.
 */
-static void sensel_connect(t_sensel *x, t_symbol *s)
+static void sensel_poll_blobs(t_sensel *x, const SenselFrameData *frame, const unsigned char *zones)
 {
-	post("sensel: connecting to device with serial number %s...", s->s_name);
+	const SenselSensorInfo *info = &x->x_hub->h_info;
+	int rows = info->num_rows, cols = info->num_cols;
+	const unsigned char *labels = frame->labels_array;
+	const float *force = ((frame->content_bit_mask & FRAME_CONTENT_PRESSURE_MASK)
+		? frame->force_array : NULL);
+	t_sensel_blob *blobs = x->x_thread_blob;
+	t_sensel_slot *args;
+	unsigned char found[256];
+	int n_found = 0;
 
-	if (x->x_connected == 1)
+	for (int r = 0; r < rows; r++)
 	{
-		error("sensel: connect failed--device already connected.");
-		return;
-	}
+		const unsigned char *row = labels + r * cols;
+		const unsigned char *above = (r > 0 ? row - cols : NULL);
+		const unsigned char *below = (r < rows - 1 ? row + cols : NULL);
 
-	if (check_if_already_on_sensel_device_list(s))
-	{
-		error("sensel: connect failed--device is already connected to another sensel object.");
-		return;
-	}
+		for (int c = 0; c < cols; c++)
+		{
+			unsigned char label = row[c];
 
-	// List of all available Sensel devices
-	SenselDeviceList list;
+			if (label == SENSEL_NULL_LABEL)
+				continue;
 
-	// Get a list of available Sensel devices
-	senselGetDeviceList(&list);
-	if (list.num_devices == 0)
-	{
-		error("sensel: connect failed--no device found.");
-		return;
+			t_sensel_blob *b = &blobs[label];
+			float w = (force != NULL ? force[r * cols + c] : 1);
+
+			if (b->b_cells++ == 0)
+			{
+				found[n_found++] = label;
+				b->b_row = r;
+				b->b_col = c;
+				b->b_force = b->b_x = b->b_y = b->b_xx = b->b_yy = b->b_xy = 0;
+				b->b_edges_x = b->b_edges_y = 0;
+			}
+
+			float dx = c - b->b_col, dy = r - b->b_row;
+
+			b->b_force += w;
+			b->b_x += w * dx;
+			b->b_y += w * dy;
+			b->b_xx += w * dx * dx;
+			b->b_yy += w * dy * dy;
+			b->b_xy += w * dx * dy;
+			b->b_edges_y += (c == 0 || row[c - 1] != label) + (c == cols - 1 || row[c + 1] != label);
+			b->b_edges_x += (above == NULL || above[c] != label) + (below == NULL || below[c] != label);
+		}
 	}
 
-	int result = senselOpenDeviceBySerialNum(&x->x_handle, (unsigned char *)s->s_name);
+	// cells to mm
+	float cw = info->width / cols, ch = info->height / rows;
 
-	if (!result)
+	for (int c = 0; c < frame->n_contacts; c++)
 	{
-		// Set the frame content to scan contact data
-		senselSetFrameContent(x->x_handle, FRAME_CONTENT_CONTACTS_MASK);
-		// Allocate a frame of data, must be done before reading frame data
-		senselAllocateFrameData(x->x_handle, &x->x_frame);
-		post("sensel: successfully connected to device with a serial number %s.", s->s_name);
-		x->x_connected = 1;
+		t_sensel_blob *b = &blobs[frame->contacts[c].id];
 
-		x->x_serial = s;
-		add_connected_to_sensel_device_list(x->x_serial);
+		if (!zones[c] || b->b_cells == 0)
+			continue;
+		if ((args = sensel_ring_push(&x->x_ring, SENSEL_RECORD_BLOB, 1 + SENSEL_BLOB_FIELDS)) == NULL)
+			break;
 
-		// sensel_connected_devices[0] = *gensym("blah");
-		outlet_float(x->x_outlet_status, x->x_connected);
+		float mx = 0, my = 0, mxx = 0, myy = 0, mxy = 0;
+		if (b->b_force > 0)
+		{
+			mx = b->b_x / b->b_force;
+			my = b->b_y / b->b_force;
+			mxx = b->b_xx / b->b_force - mx * mx;
+			myy = b->b_yy / b->b_force - my * my;
+			mxy = b->b_xy / b->b_force - mx * my;
+		}
+		args[0].s_float = frame->contacts[c].id;
+		args[1].s_float = b->b_cells;
+		args[2].s_float = (b->b_col + mx) * cw;
+		args[3].s_float = (b->b_row + my) * ch;
+		args[4].s_float = mxx * cw * cw;
+		args[5].s_float = myy * ch * ch;
+		args[6].s_float = mxy * cw * ch;
+		args[7].s_float = b->b_edges_x * cw + b->b_edges_y * ch;
 	}
 
-	if (x->x_connected != 1) {
-		error("sensel: connect failed--device with a serial number %s not found.", s->s_name);
-	}
+	for (int i = 0; i < n_found; i++)
+		blobs[found[i]].b_cells = 0;
 }
 
 /*
-	Discovers and connects to the first available Sensel Morph
+	Queues a record for every current contact of a frame, each
+	comprised of 20 data points, listed clearly in the code.
+	The frame is shared with the device's other subscribers, so
+	it is only ever read here.
 */
-static void sensel_discover(t_sensel *x)
+static void sensel_poll_frame(t_sensel *x, const SenselFrameData *frame, int last,
+	unsigned long long time, unsigned long long now, unsigned int timestamp)
 {
+	t_sensel_slot *args;
+	t_sensel_process *process = &x->x_thread_process;
+	const SenselSensorInfo *info = &x->x_hub->h_info;
+	t_sensel_stats *stats = &x->x_thread_stats;
+	float fields[SENSEL_FIELDS];
+	unsigned char zones[256], changed[256];
 
-	if (x->x_connected == 1)
+	sensel_stats_count(&stats->s_frames, 1, 0);
+	sensel_stats_count(&stats->s_contacts, frame->n_contacts, 0);
+	sensel_stats_count(&stats->s_max_contacts, frame->n_contacts, 1);
+	if (frame->lost_frame_count > 0)
+		sensel_stats_count(&stats->s_lost, frame->lost_frame_count, 0);
+
+	if (x->x_thread_recorder != NULL)
 	{
-		error("sensel: discover failed--device already connected.");
-		return;
+		// a recording the file could not take is stopped
+		if (atomic_load_explicit(&x->x_thread_recorder->r_failed, memory_order_relaxed))
+			sensel_thread_stop_recording(x);
+		else
+			sensel_recorder_frame(x->x_thread_recorder, info, frame, now, timestamp);
 	}
+	sensel_snapshot_write(&x->x_snapshot, frame, time);
 
-	// List of all available Sensel devices
-	SenselDeviceList list;
+	// the frame's records go out when it is due, and
+	// how long after its read that is goes into the stats
+	if ((args = sensel_ring_push(&x->x_ring, SENSEL_RECORD_TIME, 4)) != NULL)
+	{
+		args[0].s_header = (unsigned int)(time >> 32);
+		args[1].s_header = (unsigned int)time;
+		args[2].s_header = (unsigned int)(now >> 32);
+		args[3].s_header = (unsigned int)now;
+	}
+	unsigned int mark = x->x_ring.r_pending;
 
-	// Get a list of available Sensel devices
-	senselGetDeviceList(&list);
-	if (list.num_devices == 0)
+	// only the latest force image is ever output, but temporal
+	// smoothing has to see every frame (the force may only be
+	// there for another subscriber)
+	if ((frame->content_bit_mask & FRAME_CONTENT_PRESSURE_MASK)
+		&& (sensel_thread_content(x) & FRAME_CONTENT_PRESSURE_MASK)
+		&& (last || process->p_smooth < 1))
 	{
-		error("sensel: discover failed--no device found.");
-		return;
+		int rows = info->num_rows, cols = info->num_cols;
+		const float *force = sensel_process_frame(process, frame->force_array, rows, cols);
+
+		if (last)
+			sensel_image_render(&x->x_image, force, rows, cols,
+				x->x_thread_pressure, process->p_rows, process->p_cols);
 	}
 
-	int i = 0;
-	int found = 0;
+	// with zones every contact is tagged with its zone's id
+	int n = sensel_poll_zones(x, frame, zones);
+	int filtered = sensel_poll_filter(x, frame, time);
+	int moved = sensel_poll_deadband(x, frame, zones, filtered, changed);
+	int tag = (x->x_thread_zones != NULL);
+	int size = tag + x->x_thread_n_fields;
 
-	while(i < list.num_devices)
+	if (x->x_thread_format == SENSEL_FORMAT_FRAME)
 	{
-		if (!check_if_already_on_sensel_device_list(gensym((const char *)list.devices[i].serial_num)))
+		// one flat record: the contact count, then the
+		// selected fields of every contact in turn (an
+		// idle surface only gets the first empty frame,
+		// and a frame nothing changed enough in is left out)
+		int k = 1;
+
+		if ((n > 0 || x->x_n_contacts > 0) && (moved > 0 || n != x->x_n_contacts)
+			&& (args = sensel_ring_push(&x->x_ring,
+			SENSEL_RECORD_FRAME, 1 + n * size)) != NULL)
 		{
-			found = 1;
-			break;
+			x->x_n_contacts = n;
+			args[0].s_float = n;
+			for (int c = 0; c < frame->n_contacts; c++)
+			{
+				if (!zones[c])
+					continue;
+				if (tag)
+					args[k++].s_float = x->x_thread_zones->z_zones[zones[c] - 1].z_id;
+				sensel_poll_fields(x, &frame->contacts[c], filtered, fields);
+				for (int i = 0; i < x->x_thread_n_fields; i++)
+					args[k++].s_float = fields[x->x_thread_fields[i]];
+			}
 		}
-		i++;
 	}
-	if (!found)
+	else
 	{
-		error("sensel: discover failed--all discoverable devices are already connected to another sensel object.");
-		return;
+		for (int c = 0; c < frame->n_contacts; c++)
+		{
+			if (!changed[c])
+				continue;
+			if ((args = sensel_ring_push(&x->x_ring, SENSEL_RECORD_CONTACT, size)) == NULL)
+				break;
+			if (tag)
+				args[0].s_float = x->x_thread_zones->z_zones[zones[c] - 1].z_id;
+			sensel_poll_fields(x, &frame->contacts[c], filtered, fields);
+			for (int i = 0; i < x->x_thread_n_fields; i++)
+				args[tag + i].s_float = fields[x->x_thread_fields[i]];
+		}
+		// output a total number of contacts
+		if (n != x->x_n_contacts)
+		{
+			if ((args = sensel_ring_push(&x->x_ring, SENSEL_RECORD_CONTACTS, 1)) != NULL)
+			{
+				args[0].s_float = n;
+				x->x_n_contacts = n;
+			}
+		}
 	}
- 
-	// Open a Sensel device by the id in the SenselDeviceList, handle initialized 
-	senselOpenDeviceByID(&x->x_handle, list.devices[i].idx);
-
-	// Set the frame content to scan contact data
-	senselSetFrameContent(x->x_handle, FRAME_CONTENT_CONTACTS_MASK);
 
-	// Allocate a frame of data, must be done before reading frame data
-	senselAllocateFrameData(x->x_handle, &x->x_frame);
-
-	// Post information to the Pd console
-	post("sensel: successfully connected to device with a serial number %s.", list.devices[i].serial_num);
-
-	x->x_serial = gensym((const char *)list.devices[i].serial_num);
-	add_connected_to_sensel_device_list(x->x_serial);
-
-	x->x_connected = 1;
-
-	outlet_float(x->x_outlet_status, x->x_connected);
-}
-
-/*
-	Lists serial numbers of all available Sensel Morphs
-*/
-static void sensel_identify(t_sensel *x)
-{
-	// disable polling while doing identifying
-	// as this tends to misbehave on Macs when
-	// it gets this request while outputting data
-	pthread_mutex_lock(&x->x_unsafe_mutex);
-	
-	// List of all available Sensel devices
-	SenselDeviceList list;
+	if (x->x_thread_accel_frames > 0 && (frame->content_bit_mask & FRAME_CONTENT_ACCEL_MASK))
+		sensel_poll_accel(x, frame);
+	if (x->x_thread_blobs && (frame->content_bit_mask & FRAME_CONTENT_LABELS_MASK))
+		sensel_poll_blobs(x, frame, zones);
 
-	// Get a list of available Sensel devices
-	senselGetDeviceList(&list);
-	if (list.num_devices == 0)
+	// gestures see every frame, at the positions that are output
+	if (x->x_thread_gestures.g_on)
 	{
-		post("sensel: identify found no devices.");
-		return;
-	}
+		float pos[2 * 256];
 
-	post("sensel: identify found following devices:");
+		for (int c = 0; c < frame->n_contacts; c++)
+		{
+			const SenselContact *contact = &frame->contacts[c];
+			const float *out = x->x_thread_track[contact->id].t_out;
 
-	int i;
-	for (i = 0; i < list.num_devices; i++)
+			pos[2 * c] = (filtered ? out[0] : contact->x_pos);
+			pos[2 * c + 1] = (filtered ? out[1] : contact->y_pos);
+		}
+		sensel_gestures_frame(&x->x_thread_gestures, &x->x_ring, frame, zones, pos, time);
+	}
+	// publish the frame (or count it as dropped), a due
+	// time on its own is not worth waking Pd for
+	if (x->x_ring.r_pending == mark && !x->x_ring.r_failed)
+		sensel_ring_discard(&x->x_ring);
+	else
 	{
-		post("%d: %s", i+1, list.devices[i].serial_num);
+		sensel_ring_commit(&x->x_ring);
+		sensel_stats_count(&stats->s_ring_high, x->x_ring.r_pending
+			- atomic_load_explicit(&x->x_ring.r_read, memory_order_relaxed), 1);
 	}
-	// reenable polling since we are now done
-	pthread_mutex_unlock(&x->x_unsafe_mutex);
 }
 
 /*
-	Polls for the Sensel contact data. Outputs a list for every
-	current contact, each comprised of 19 data points, listed
-	clearly in the code.
+	Polls for the Sensel contact data. Every frame is read and
+	decoded once, then queued by each subscriber that has started,
+	whose output is scheduled.
 */
-static void sensel_poll(t_sensel *x)
+static void sensel_poll(t_sensel_hub *h)
 {
+	unsigned int num_frames = 0;
+	unsigned long long read = sensel_monotonic_usec();
+	t_sensel *x;
 
-	if (x->x_connected == 1)
-	{
-
-		unsigned int num_frames = 0;
-
-		t_data *temp;
-
-		// Read all available data from the Sensel device
-		senselReadSensor(x->x_handle);
-
-		senselGetNumAvailableFrames(x->x_handle, &num_frames);
-
-		for (unsigned int f = 0; f < num_frames; f++)
-		{
-
-			// Read one frame of data
-			senselGetFrame(x->x_handle, x->x_frame);
-
-			for (int c = 0; c < x->x_frame->n_contacts; c++)
-			{
-
-				if (x->x_data == NULL) // this is the first time around
-				{
-					x->x_data = (t_data *)getbytes(sizeof(t_data));
-					x->x_data->next = NULL;
-					x->x_data->type = 0;
+	// Read all available data from the Sensel device, a device
+	// that keeps failing to read has been unplugged
+	if (h->h_backend->b_read_sensor(h->h_handle) != SENSEL_OK)
+		h->h_read_errors++;
+	else
+		h->h_read_errors = 0;
 
-					x->x_data_end = x->x_data;
-				}
-				else
-				{
-					temp = (t_data *)getbytes(sizeof(t_data));
-					temp->next = NULL;
-					temp->type = 0;
+	h->h_backend->b_get_num_available_frames(h->h_handle, &num_frames);
+	unsigned long long now = sensel_monotonic_usec();
+	unsigned int timestamp = 0;
 
-					x->x_data_end->next = temp;
-					x->x_data_end = temp;
-				}
+	for (x = h->h_subscribers; x != NULL; x = x->x_hub_next)
+		if (x->x_thread_connected)
+			sensel_histogram_add(&x->x_thread_stats.s_read, now - read);
 
-				SETFLOAT(&(x->x_data_end->args[0]), x->x_frame->contacts[c].id);
-				SETFLOAT(&(x->x_data_end->args[1]), x->x_frame->contacts[c].state);
-				SETFLOAT(&(x->x_data_end->args[2]), x->x_frame->contacts[c].orientation);
-				SETFLOAT(&(x->x_data_end->args[3]), x->x_frame->contacts[c].major_axis);
-				SETFLOAT(&(x->x_data_end->args[4]), x->x_frame->contacts[c].minor_axis);
-				SETFLOAT(&(x->x_data_end->args[5]), x->x_frame->contacts[c].delta_x);
-				SETFLOAT(&(x->x_data_end->args[6]), x->x_frame->contacts[c].delta_y);
-				SETFLOAT(&(x->x_data_end->args[7]), x->x_frame->contacts[c].delta_force);
-				SETFLOAT(&(x->x_data_end->args[8]), x->x_frame->contacts[c].delta_area);
-				SETFLOAT(&(x->x_data_end->args[9]), x->x_frame->contacts[c].min_x);
-				SETFLOAT(&(x->x_data_end->args[10]), x->x_frame->contacts[c].min_y);
-				SETFLOAT(&(x->x_data_end->args[11]), x->x_frame->contacts[c].max_x);
-				SETFLOAT(&(x->x_data_end->args[12]), x->x_frame->contacts[c].max_y);
-				SETFLOAT(&(x->x_data_end->args[13]), x->x_frame->contacts[c].peak_x);
-				SETFLOAT(&(x->x_data_end->args[14]), x->x_frame->contacts[c].peak_y);
-				SETFLOAT(&(x->x_data_end->args[16]), x->x_frame->contacts[c].x_pos);
-				SETFLOAT(&(x->x_data_end->args[17]), x->x_frame->contacts[c].y_pos);
-				SETFLOAT(&(x->x_data_end->args[19]), x->x_frame->contacts[c].area);
-
-				if (x->x_frame->contacts[c].state != 3)
-				{
-					SETFLOAT(&(x->x_data_end->args[15]), x->x_frame->contacts[c].peak_force);
-					SETFLOAT(&(x->x_data_end->args[18]), x->x_frame->contacts[c].total_force);
-				}
-				else
-				{
-					SETFLOAT(&(x->x_data_end->args[15]), 0);
-					SETFLOAT(&(x->x_data_end->args[18]), 0);
-				}
+	// without a device timestamp, frames are timed by their read
+	int stamped = (num_frames > 0
+		&& h->h_backend->b_get_timestamp(h->h_handle, &timestamp) == SENSEL_OK);
+	if (stamped)
+		sensel_clock_update(&h->h_clock, timestamp, num_frames, now);
 
-				x->x_data_end->type = 0;
-			}
-			// output a total number of contacts
-			if (x->x_frame->n_contacts != x->x_n_contacts)
-			{
-				if (x->x_data == NULL) // this is the first time around
-				{
-					x->x_data = (t_data *)getbytes(sizeof(t_data));
-					x->x_data->next = NULL;
-					x->x_data->type = 1;
+	for (unsigned int f = 0; f < num_frames; f++)
+	{
+		unsigned int back = num_frames - 1 - f;
+		unsigned long long time = (stamped ? sensel_clock_map(&h->h_clock, back) : now);
+		unsigned int stamp = (stamped ? timestamp - (unsigned int)(back * h->h_clock.c_period) : 0);
 
-					x->x_data_end = x->x_data;
-				}
-				else
-				{
-					temp = (t_data *)getbytes(sizeof(t_data));
-					temp->next = NULL;
-					temp->type = 1;
+		// Read one frame of data
+		h->h_backend->b_get_frame(h->h_handle, h->h_frame);
+		for (x = h->h_subscribers; x != NULL; x = x->x_hub_next)
+			if (x->x_thread_connected)
+				sensel_poll_frame(x, h->h_frame, (f == num_frames - 1), time, now, stamp);
+	}
 
-					x->x_data_end->next = temp;
-					x->x_data_end = temp;
-				}
-				SETFLOAT(&(x->x_data_end->args[0]), x->x_frame->n_contacts);
-				x->x_n_contacts = x->x_frame->n_contacts;
-			}
-		}
+	for (x = h->h_subscribers; x != NULL; x = x->x_hub_next)
+	{
+		if (!x->x_thread_connected)
+			continue;
 
-		if (x->x_data != NULL)
-        {
+		// an image held back by a busy front buffer goes out
+		// as soon as the Pd thread is done with the previous one
+		int output = (num_frames > 0);
+		if (sensel_image_publish(&x->x_image))
+			output = 1;
+		if (output && !atomic_exchange(&x->x_clock_set, 1))
 			clock_delay(x->x_clock_output, 0);
-            x->x_clock_set = 1;
-        }
 	}
 }
 
@@ -582,61 +7043,120 @@ static void *sensel_new()
 
 	x->x_outlet_data = outlet_new(&x->x_obj, &s_list);
 	x->x_outlet_status = outlet_new(&x->x_obj, &s_float);
+	x->x_outlet_gesture = outlet_new(&x->x_obj, 0);
+	x->x_outlet_accel = outlet_new(&x->x_obj, &s_list);
 
+	x->x_canvas = canvas_getcurrent();
 	x->x_connected = 0;
+	x->x_connecting = 0;
+	x->x_recording = 0;
+	x->x_serial = NULL;
+	x->x_pressure = NULL;
+	x->x_pressure_rows = NULL;
+	x->x_pressure_cols = NULL;
+	x->x_pressure_warned = 0;
+	x->x_led_array = NULL;
+	x->x_led_warned = 0;
+	x->x_led_period = 1000.0 / SENSEL_LED_RATE;
+	x->x_latency = 0;
+	x->x_logical = 0;
+	x->x_logical_valid = 0;
+	x->x_thread_recorder = NULL;
+	x->x_thread_pressure = 0;
+	x->x_thread_format = SENSEL_FORMAT_CONTACTS;
+	x->x_thread_n_fields = SENSEL_FIELDS;
+	for (int i = 0; i < SENSEL_FIELDS; i++)
+		x->x_thread_fields[i] = i;
+	x->x_thread_contacts_mask = sensel_contacts_mask(SENSEL_FIELDS_ALL);
+	sensel_stats_reset(&x->x_thread_stats);
+	sensel_histogram_reset(&x->x_stats_latency);
+	x->x_stats_frames = 0;
+	x->x_stats_time = sensel_monotonic_usec();
+	x->x_thread_process.p_work = NULL;
+	x->x_thread_process.p_cells = 0;
+	sensel_process_set(&x->x_thread_process, SENSEL_IMAGE_RESET, 0);
+	x->x_thread_open = 0;
 	x->x_thread_connected = 0;
 	x->x_n_contacts = 0;
-	x->x_frame = NULL;
-	x->x_data =  NULL;
-	x->x_data_end = NULL;
-
-	for (int i = 0; i < 24; i++)
-	{
-		x->x_led[i] = 0;
-		x->x_thread_led[i] = 0;
-	}
+	x->x_hub = NULL;
+	x->x_hub_next = NULL;
+	x->x_ring.r_slots = NULL;
+	x->x_ring.r_size = 0;
+	x->x_out_args = NULL;
+	x->x_out_size = 0;
+	x->x_zones = NULL;
+	x->x_thread_zones = NULL;
+	for (int i = 0; i < SENSEL_DEADBANDS; i++)
+		x->x_thread_deadband[i] = 0;
+	x->x_thread_filter.f_type = SENSEL_FILTER_OFF;
+	x->x_thread_filter.f_smooth = 1;
+	x->x_thread_filter.f_mincutoff = 1;
+	x->x_thread_filter.f_beta = 0;
+	x->x_thread_filter.f_dcutoff = 1;
+	x->x_thread_filter.f_predict = 0;
+	x->x_thread_gestures.g_on = 0;
+	x->x_thread_accel_frames = 0;
+	x->x_thread_accel_threshold = 0;
+	x->x_thread_accel_count = 0;
+	x->x_thread_accel_valid = 0;
+	x->x_thread_blobs = 0;
+	for (int i = 0; i < 256; i++)
+		x->x_thread_blob[i].b_cells = 0;
+	x->x_thread_hotplug = 0;
+	x->x_thread_lost[0] = '\0';
+	sensel_gestures_reset(&x->x_thread_gestures);
+	sensel_snapshot_init(&x->x_snapshot);
+	x->x_next = sensel_objects;
+	sensel_objects = x;
+	x->x_image.i_data[0] = x->x_image.i_data[1] = NULL;
+	x->x_image.i_cells = 0;
+	atomic_init(&x->x_image.i_full, 0);
+	x->x_overflow_reported = 0;
 
 	x->x_clock_output = clock_new(x, (t_method)sensel_output_data);
-    x->x_clock_set = 0;
+	atomic_init(&x->x_clock_set, 0);
+	x->x_clock_latency = clock_new(x, (t_method)sensel_output_data);
+	x->x_clock_reply = clock_new(x, (t_method)sensel_process_replies);
+	atomic_init(&x->x_reply_set, 0);
+	x->x_clock_leds = clock_new(x, (t_method)sensel_sample_leds);
+	for (int i = 0; i < SENSEL_LEDS; i++)
+		atomic_init(&x->x_led_table[i], -1);
+	atomic_init(&x->x_led_table_set, 0);
+
+	sensel_queue_alloc(&x->x_commands, sizeof(t_sensel_command), SENSEL_COMMAND_QUEUE_SIZE);
+	sensel_queue_alloc(&x->x_replies, sizeof(t_sensel_reply), SENSEL_REPLY_QUEUE_SIZE);
+
+	// the Sensel thread takes the object on with its first command
+	x->x_attached = 0;
+	atomic_init(&x->x_detached, 0);
+	x->x_thread_next = NULL;
 
-	// prep the secondary thread init variable
-	x->x_unsafe = 1;
-	
 	// initialize 10ms polling time expressed in useconds
-	x->x_poll_wait = 10000;
+	x->x_thread_poll_wait = 10000;
+	x->x_thread_led_period = 1000000 / SENSEL_LED_RATE;
 
-	t_threadedFunctionParams rPars;
-	rPars.s_inst = x;
-	pthread_mutex_init(&x->x_unsafe_mutex, NULL);
-	//pthread_cond_init(&x->x_unsafe_cond, NULL);
-	pthread_create( &x->x_unsafe_t, NULL, (void *) &sensel_pthreadForAudioUnfriendlyOperations, (void *) &rPars);
+	// start in the sleep-based poll mode
+	x->x_thread_mode = SENSEL_MODE_POLL;
 
-	// wait until other thread has properly intialized so that
-	// rPars do not get destroyed before the thread has gotten its
-	// pointer information
-	while(x->x_unsafe == 1)
-	{
-		sched_yield();
-	}
+	// a simulated device defaults to a full hand at the Morph's rate
+	x->x_thread_sim.c_contacts = 5;
+	x->x_thread_sim.c_rate = 125;
+	x->x_thread_sim.c_noise = 0;
+	x->x_thread_sim.c_seed = 1;
+	x->x_thread_sim.c_skew = 0;
 
 	return(x);
 }
 
 /*
-	Disconnects the Sensel Morph
+	Disconnects the Sensel Morph. The thread closes the device
+	and the status outlet is updated once it reports back.
 */
 static void sensel_disconnect(t_sensel *x)
 {
 	if (x->x_connected)
 	{
-		x->x_connected = 0;
-		while(x->x_thread_connected != x->x_connected)
-			sched_yield();
-
-		remove_connected_to_sensel_device_list(x->x_serial);
-		x->x_serial = NULL;
-
-		outlet_float(x->x_outlet_status, x->x_connected);
+		sensel_send_command(x, SENSEL_COMMAND_DISCONNECT, 0, 0, NULL);
 	}
 	else
 	{
@@ -650,26 +7170,251 @@ static void sensel_disconnect(t_sensel *x)
 */
 static void sensel_free(t_sensel * x)
 {
-	if (x->x_connected) {
-		sensel_disconnect(x);
+	// the Sensel thread closes any open device as it lets go
+	if (x->x_attached)
+	{
+		sensel_reactor_event(SENSEL_REACTOR_DETACH, x);
+		while (!atomic_load(&x->x_detached))
+			usleep(1000);
 	}
 
-	x->x_unsafe = -1;
+	clock_free(x->x_clock_output);
+	clock_free(x->x_clock_latency);
+	clock_free(x->x_clock_reply);
+	clock_free(x->x_clock_leds);
+
+	sensel_queue_free(&x->x_commands);
+	sensel_queue_free(&x->x_replies);
+	sensel_ring_free(&x->x_ring);
+	sensel_image_free(&x->x_image);
+	freebytes(x->x_out_args, x->x_out_size * sizeof(t_atom));
+	// the thread is done with its table as well
+	if (x->x_zones != NULL)
+		freebytes(x->x_zones, sizeof(t_sensel_zones));
+	if (x->x_thread_zones != NULL)
+		freebytes(x->x_thread_zones, sizeof(t_sensel_zones));
 
-	pthread_join(x->x_unsafe_t, NULL);
-	pthread_mutex_destroy(&x->x_unsafe_mutex);
+	for (t_sensel **s = &sensel_objects; *s != NULL; s = &(*s)->x_next)
+	{
+		if (*s == x)
+		{
+			*s = x->x_next;
+			break;
+		}
+	}
+}
 
-	clock_free(x->x_clock_output);
+/*
+	[sensel~]: the contacts of a [sensel] object's device as
+	signals, x, y, force and gate for each voice (contact id).
+	Frames are timestamped when the Sensel thread reads them
+	and rendered a fixed delay behind, interpolating between
+	the two frames around every sample, so strikes land where
+	they happened rather than on the next block boundary.
+*/
+#define SENSEL_TILDE_HISTORY		8		// frames kept for interpolation
+#define SENSEL_TILDE_DELAY			10		// default render delay in msec
+#define SENSEL_TILDE_RESYNC			50000	// usec of clock error to snap to
+
+static t_class *sensel_tilde_class;
+
+typedef struct _sensel_tilde
+{
+	t_object x_obj;
+	t_symbol *x_device;			// serial number, or NULL for the first device
+	int x_voices;
+	t_sample **x_outs;			// x, y, force and gate of each voice
+	float x_delay;				// usec frames are rendered behind
+	double x_sr;
+	double x_time;				// usec of the next block's first sample
+	t_sensel_snapshot x_history[SENSEL_TILDE_HISTORY];
+	int x_frames;				// frames in the history, oldest first
+	t_sensel_snapshot x_read;
+} t_sensel_tilde;
+
+/*
+	The [sensel] object the signals follow, if connected
+*/
+static t_sensel *sensel_tilde_find(t_sensel_tilde *x)
+{
+	for (t_sensel *s = sensel_objects; s != NULL; s = s->x_next)
+		if (s->x_connected == 1 && (x->x_device == NULL || s->x_serial == x->x_device))
+			return(s);
+	return(NULL);
+}
+
+/*
+	Appends the device's latest frame to the history
+*/
+static void sensel_tilde_update(t_sensel_tilde *x)
+{
+	t_sensel *device = sensel_tilde_find(x);
+
+	if (device == NULL)
+	{
+		x->x_frames = 0;
+		return;
+	}
+	if (sensel_snapshot_read(&device->x_snapshot, &x->x_read) < 0 || x->x_read.s_frame == 0)
+		return;
+	if (x->x_frames > 0 && (x->x_history[x->x_frames - 1].s_frame == x->x_read.s_frame
+		|| x->x_history[x->x_frames - 1].s_time > x->x_read.s_time))
+	{
+		return;
+	}
+	if (x->x_frames == SENSEL_TILDE_HISTORY)
+	{
+		memmove(&x->x_history[0], &x->x_history[1], (SENSEL_TILDE_HISTORY - 1) * sizeof(t_sensel_snapshot));
+		x->x_frames--;
+	}
+	x->x_history[x->x_frames++] = x->x_read;
+}
+
+static t_int *sensel_tilde_perform(t_int *w)
+{
+	t_sensel_tilde *x = (t_sensel_tilde *)(w[1]);
+	int n = (int)(w[2]);
+	double now = (double)sensel_monotonic_usec();
+	double step = 1000000.0 / x->x_sr;
+
+	sensel_tilde_update(x);
+
+	// follow the wall clock slowly, so that blocks computed in
+	// bursts still get evenly spaced sample times
+	if (x->x_time == 0 || fabs(now - x->x_time) > SENSEL_TILDE_RESYNC)
+		x->x_time = now;
+	else
+		x->x_time += (now - x->x_time) * 0.01;
+
+	if (x->x_frames == 0)
+	{
+		for (int o = 0; o < 4 * x->x_voices; o++)
+			for (int i = 0; i < n; i++)
+				x->x_outs[o][i] = 0;
+	}
+	else
+	{
+		int k = 0;
+
+		for (int i = 0; i < n; i++)
+		{
+			double t = x->x_time + i * step - x->x_delay;
+
+			// the last frame at or before t (samples only move forward)
+			while (k + 1 < x->x_frames && (double)x->x_history[k + 1].s_time <= t)
+				k++;
+
+			const t_sensel_snapshot *a = &x->x_history[k];
+			const t_sensel_snapshot *b = (k + 1 < x->x_frames ? &x->x_history[k + 1] : a);
+			double span = (double)b->s_time - (double)a->s_time;
+			float f = (span > 0 && t > (double)a->s_time ? (float)((t - (double)a->s_time) / span) : 0);
+
+			if (t < (double)a->s_time)
+				b = a;
+			for (int v = 0; v < x->x_voices; v++)
+			{
+				const t_sensel_voice *va = &a->s_voices[v], *vb = &b->s_voices[v];
+				t_sample **out = x->x_outs + 4 * v;
+
+				// a new touch starts where it lands, not where
+				// the previous one was lifted
+				if (va->v_gate == 0)
+				{
+					out[0][i] = vb->v_x;
+					out[1][i] = vb->v_y;
+				}
+				else
+				{
+					out[0][i] = va->v_x + (vb->v_x - va->v_x) * f;
+					out[1][i] = va->v_y + (vb->v_y - va->v_y) * f;
+				}
+				out[2][i] = va->v_force + (vb->v_force - va->v_force) * f;
+				out[3][i] = va->v_gate;
+			}
+		}
+	}
+
+	x->x_time += n * step;
+	return(w + 3);
+}
+
+static void sensel_tilde_dsp(t_sensel_tilde *x, t_signal **sp)
+{
+	x->x_sr = sp[0]->s_sr;
+	for (int o = 0; o < 4 * x->x_voices; o++)
+		x->x_outs[o] = sp[o]->s_vec;
+	dsp_add(sensel_tilde_perform, 2, x, (t_int)sp[0]->s_n);
+}
+
+/*
+	Follows another device: "set <serial-number>", or "set" for
+	the first connected one
+*/
+static void sensel_tilde_set(t_sensel_tilde *x, t_symbol *s, int argc, t_atom *argv)
+{
+	(void)s;
+	x->x_device = (argc > 0 && argv[0].a_type == A_SYMBOL ? argv[0].a_w.w_symbol : NULL);
+	x->x_frames = 0;
+}
+
+/*
+	Sets how far behind the device the signals are rendered, in
+	msec; it should cover at least one frame period
+*/
+static void sensel_tilde_delay(t_sensel_tilde *x, t_floatarg f)
+{
+	x->x_delay = (f > 0 ? f * 1000 : 0);
+}
+
+/*
+	[sensel~ [serial-number] [voices]]
+*/
+static void *sensel_tilde_new(t_symbol *s, int argc, t_atom *argv)
+{
+	t_sensel_tilde *x = (t_sensel_tilde *)pd_new(sensel_tilde_class);
+	(void)s;
 
-	// delete any leftover single-linked output data list
-	t_data *last = NULL;
-	while (x->x_data != NULL)
+	x->x_device = NULL;
+	x->x_voices = 4;
+	for (int i = 0; i < argc; i++)
 	{
-		outlet_list(x->x_outlet_data, gensym("list"), 19, x->x_data->args);
-		last = x->x_data;
-		x->x_data = x->x_data->next;
-		free(last);
+		if (argv[i].a_type == A_SYMBOL)
+			x->x_device = argv[i].a_w.w_symbol;
+		else if (argv[i].a_type == A_FLOAT)
+			x->x_voices = (int)argv[i].a_w.w_float;
 	}
+	if (x->x_voices < 1)
+		x->x_voices = 1;
+	if (x->x_voices > SENSEL_VOICES)
+		x->x_voices = SENSEL_VOICES;
+
+	x->x_outs = (t_sample **)getbytes(4 * x->x_voices * sizeof(t_sample *));
+	for (int o = 0; o < 4 * x->x_voices; o++)
+		outlet_new(&x->x_obj, &s_signal);
+	x->x_delay = SENSEL_TILDE_DELAY * 1000;
+	x->x_sr = 44100;
+	x->x_time = 0;
+	x->x_frames = 0;
+	return(x);
+}
+
+static void sensel_tilde_free(t_sensel_tilde *x)
+{
+	freebytes(x->x_outs, 4 * x->x_voices * sizeof(t_sample *));
+}
+
+static void sensel_tilde_setup(void)
+{
+	sensel_tilde_class = class_new(gensym("sensel~"),
+		(t_newmethod)sensel_tilde_new, (t_method)sensel_tilde_free,
+		sizeof(t_sensel_tilde), CLASS_DEFAULT, A_GIMME, 0);
+	class_addmethod(sensel_tilde_class, (t_method)sensel_tilde_dsp,
+		gensym("dsp"), A_CANT, 0);
+	class_addmethod(sensel_tilde_class, (t_method)sensel_tilde_set,
+		gensym("set"), A_GIMME, 0);
+	class_addmethod(sensel_tilde_class, (t_method)sensel_tilde_delay,
+		gensym("delay"), A_FLOAT, 0);
+	class_sethelpsymbol(sensel_tilde_class, gensym("sensel"));
 }
 
 /*
@@ -677,6 +7422,9 @@ static void sensel_free(t_sensel * x)
 */
 void sensel_setup(void)
 {
+	sensel_kernels_select();
+	sensel_reactor_init();
+
 	sensel_class = class_new(gensym("sensel"), 
 		(t_newmethod)sensel_new, (t_method)sensel_free, 
 		sizeof(t_sensel), CLASS_DEFAULT, 0);
@@ -692,6 +7440,52 @@ void sensel_setup(void)
 		gensym("identify"), 0);
 	class_addmethod(sensel_class, (t_method)sensel_set_poll_wait_time,
 		gensym("poll"), A_FLOAT);
+	class_addmethod(sensel_class, (t_method)sensel_set_mode,
+		gensym("mode"), A_SYMBOL, 0);
+	class_addmethod(sensel_class, (t_method)sensel_set_sim,
+		gensym("sim"), A_SYMBOL, A_FLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_record,
+		gensym("record"), A_SYMBOL, 0);
+	class_addmethod(sensel_class, (t_method)sensel_stop,
+		gensym("stop"), 0);
+	class_addmethod(sensel_class, (t_method)sensel_replay,
+		gensym("replay"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_seek,
+		gensym("seek"), A_FLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_pressure,
+		gensym("pressure"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_image,
+		gensym("image"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_format,
+		gensym("format"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_latency,
+		gensym("latency"), A_FLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_stats,
+		gensym("stats"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_fields,
+		gensym("fields"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_zone,
+		gensym("zone"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_deadband,
+		gensym("deadband"), A_SYMBOL, A_DEFFLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_filter,
+		gensym("filter"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_predict,
+		gensym("predict"), A_FLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_gestures,
+		gensym("gestures"), A_SYMBOL, 0);
+	class_addmethod(sensel_class, (t_method)sensel_accel,
+		gensym("accel"), A_FLOAT, A_DEFFLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_blobs,
+		gensym("blobs"), A_SYMBOL, 0);
+	class_addmethod(sensel_class, (t_method)sensel_hotplug,
+		gensym("hotplug"), A_SYMBOL, 0);
 	class_addmethod(sensel_class, (t_method)sensel_set_led,
-		gensym("led"), A_FLOAT, A_FLOAT, 0);
+		gensym("led"), A_GIMME, 0);
+	class_addmethod(sensel_class, (t_method)sensel_set_led_rate,
+		gensym("ledrate"), A_FLOAT, 0);
+	class_addmethod(sensel_class, (t_method)sensel_set_led_array,
+		gensym("ledarray"), A_DEFSYM, 0);
+
+	sensel_tilde_setup();
 }